@@ -0,0 +1,165 @@
+#include "collision.h"
+#include "polygon.h"
+#include "polygon_helper.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Measures find_collision() on pairs of generated polygons:
+// for each kind of shape, vertex count, and separation,
+// how many cycles each test takes when the shapes collide and when they don't.
+// Prints a JSON object, so results can be compared across narrowphase versions.
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+// Time stamp counter ticks, which run at the CPU's nominal frequency
+#define COUNTER_NAME "tsc"
+uint64_t read_counter(void) {
+    return __rdtsc();
+}
+#else
+#define COUNTER_NAME "ns"
+uint64_t read_counter(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+#endif
+
+// Random placements of each pair of shapes, and timed calls per placement
+#define PLACEMENTS 64
+#define REPEATS 16
+#define SHAPE_RADIUS 10
+
+// Written by every test, so the calls are not optimized away
+volatile double sink = 0;
+
+typedef enum {
+    RECTANGLE,
+    POLYGON,
+    ELLIPSE
+} ShapeKind;
+
+const char *SHAPE_NAMES[] = {"rectangle", "polygon", "ellipse"};
+
+double random_between(double min, double max) {
+    return min + (max - min) * rand() / RAND_MAX;
+}
+
+// Makes a shape centered on the origin with about the given number of vertices
+List *make_shape(ShapeKind kind, int vertices) {
+    switch (kind) {
+        case RECTANGLE:
+            return rectangle_points(VEC_ZERO, 2 * SHAPE_RADIUS, SHAPE_RADIUS);
+        case POLYGON:
+            // A star factor of 1 gives a regular polygon with twice the vertices
+            return polygon_points(VEC_ZERO, vertices / 2, SHAPE_RADIUS, 1);
+        case ELLIPSE:
+        {
+            // ellipse_points() makes 2 * (steps + 1) vertices at integer x
+            // coordinates, so its x radius must exceed steps / 2
+            // to avoid repeating the end points
+            int steps = (vertices - 2) / 4 * 2;
+            return ellipse_points(VEC_ZERO, steps, steps / 2 + 1, steps / 2 + 1);
+        }
+    }
+    return NULL;
+}
+
+// The distance from the origin to the shape's furthest vertex
+double bounding_radius(List *shape) {
+    double radius = 0;
+    for (size_t i = 0; i < list_size(shape); i++) {
+        Vector *v = list_get(shape, i);
+        radius = fmax(radius, sqrt(vec_dot(*v, *v)));
+    }
+    return radius;
+}
+
+void bench_pairs(ShapeKind kind, int vertices, double separation, bool first) {
+    List *shape1 = make_shape(kind, vertices);
+    List *shape2 = make_shape(kind, vertices);
+    double distance = separation * (bounding_radius(shape1) + bounding_radius(shape2));
+
+    size_t hits = 0, misses = 0;
+    uint64_t hit_counts = 0, miss_counts = 0;
+    for (size_t p = 0; p < PLACEMENTS; p++) {
+        // Move the second shape around the first, and turn both
+        double direction = random_between(0, 2 * M_PI);
+        Vector offset = {distance * cos(direction), distance * sin(direction)};
+        double angle1 = random_between(0, 2 * M_PI);
+        double angle2 = random_between(0, 2 * M_PI);
+        polygon_rotate(shape1, angle1, VEC_ZERO);
+        polygon_rotate(shape2, angle2, VEC_ZERO);
+        polygon_translate(shape2, offset);
+
+        uint64_t start = read_counter();
+        CollisionInfo info;
+        for (size_t r = 0; r < REPEATS; r++) {
+            info = find_collision(shape1, shape2);
+            sink += info.overlap;
+        }
+        uint64_t elapsed = read_counter() - start;
+        if (info.collided) {
+            hits += REPEATS;
+            hit_counts += elapsed;
+        }
+        else {
+            misses += REPEATS;
+            miss_counts += elapsed;
+        }
+
+        polygon_translate(shape2, vec_negate(offset));
+        polygon_rotate(shape1, -angle1, VEC_ZERO);
+        polygon_rotate(shape2, -angle2, VEC_ZERO);
+    }
+
+    printf(
+        "%s    {\"shape\": \"%s\", \"vertices\": %zu, \"separation\": %g, "
+        "\"hits\": %zu, \"misses\": %zu, ",
+        first ? "" : ",\n", SHAPE_NAMES[kind], list_size(shape1), separation, hits, misses
+    );
+    if (hits > 0) {
+        printf("\"cycles_per_hit\": %.1f, ", (double) hit_counts / hits);
+    }
+    else {
+        printf("\"cycles_per_hit\": null, ");
+    }
+    if (misses > 0) {
+        printf("\"cycles_per_miss\": %.1f", (double) miss_counts / misses);
+    }
+    else {
+        printf("\"cycles_per_miss\": null");
+    }
+    printf("}");
+
+    list_free(shape1);
+    list_free(shape2);
+}
+
+int main(void) {
+    const int vertex_counts[] = {8, 16, 32, 64, 128};
+    // Distances between the shapes' centers, relative to the sum of their
+    // bounding radii: the shapes overlap deeply, partly, touch, or are apart
+    const double separations[] = {0.25, 0.75, 0.95, 1.25, 3};
+    const size_t separation_count = sizeof(separations) / sizeof(*separations);
+
+    srand(1);
+    printf("{\"benchmark\": \"collision\", \"counter\": \"%s\", \"results\": [\n", COUNTER_NAME);
+    bool first = true;
+    for (size_t s = 0; s < separation_count; s++) {
+        bench_pairs(RECTANGLE, 4, separations[s], first);
+        first = false;
+    }
+    for (ShapeKind kind = POLYGON; kind <= ELLIPSE; kind++) {
+        for (size_t v = 0; v < sizeof(vertex_counts) / sizeof(*vertex_counts); v++) {
+            for (size_t s = 0; s < separation_count; s++) {
+                bench_pairs(kind, vertex_counts[v], separations[s], false);
+            }
+        }
+    }
+    printf("\n]}\n");
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "forces.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Compares the integrators on the scenarios from tests/test_suite_forces.c:
+// for each step size, how far the energy drifts and how long each step takes
+
+typedef struct {
+    Scene *scene;
+    Body *body1;
+    Body *body2;
+} Scenario;
+
+typedef struct {
+    const char *name;
+    Scenario (*init)(Integrator integrator);
+    double (*energy)(Scenario *scenario);
+    // How many seconds to simulate
+    double duration;
+} ScenarioType;
+
+#define SPRING_M 10
+#define SPRING_K 2
+#define SPRING_A 3
+#define GRAVITY_M1 4.5
+#define GRAVITY_M2 7.3
+#define GRAVITY_G 1e3
+
+List *make_shape(void) {
+    List *shape = list_init(4, free);
+    Vector corners[] = {{-1, -1}, {+1, -1}, {+1, +1}, {-1, +1}};
+    for (size_t i = 0; i < 4; i++) {
+        Vector *v = malloc(sizeof(*v));
+        *v = corners[i];
+        list_add(shape, v);
+    }
+    return shape;
+}
+
+double kinetic_energy(Body *body) {
+    Vector v = body_get_velocity(body);
+    return body_get_mass(body) * vec_dot(v, v) / 2;
+}
+
+// A mass on a spring, as in test_spring_sinusoid()
+Scenario spring_init(Integrator integrator) {
+    Scene *scene = scene_init();
+    scene_set_integrator(scene, integrator);
+    Body *mass = body_init(make_shape(), SPRING_M, (RGBColor) {0, 0, 0});
+    body_set_centroid(mass, (Vector) {SPRING_A, 0});
+    scene_add_body(scene, mass);
+    Body *anchor = body_init(make_shape(), INFINITY, (RGBColor) {0, 0, 0});
+    scene_add_body(scene, anchor);
+    create_spring(scene, SPRING_K, mass, anchor);
+    return (Scenario) {.scene = scene, .body1 = mass, .body2 = anchor};
+}
+
+double spring_energy(Scenario *s) {
+    Vector x = vec_subtract(body_get_centroid(s->body1), body_get_centroid(s->body2));
+    return kinetic_energy(s->body1) + SPRING_K * vec_dot(x, x) / 2;
+}
+
+// The two bodies from test_energy_conservation(), but orbiting each other
+// so that they can be simulated for as long as needed without colliding
+Scenario gravity_init(Integrator integrator) {
+    Scene *scene = scene_init();
+    scene_set_integrator(scene, integrator);
+    Body *mass1 = body_init(make_shape(), GRAVITY_M1, (RGBColor) {0, 0, 0});
+    scene_add_body(scene, mass1);
+    Body *mass2 = body_init(make_shape(), GRAVITY_M2, (RGBColor) {0, 0, 0});
+    Vector r = {10, 20};
+    body_set_centroid(mass2, r);
+    scene_add_body(scene, mass2);
+    create_newtonian_gravity(scene, GRAVITY_G, mass1, mass2);
+
+    double distance = sqrt(vec_dot(r, r));
+    double speed = sqrt(GRAVITY_G * (GRAVITY_M1 + GRAVITY_M2) / distance);
+    Vector tangent = vec_multiply(speed / distance, (Vector) {-r.y, r.x});
+    double total_mass = GRAVITY_M1 + GRAVITY_M2;
+    body_set_velocity(mass1, vec_multiply(-GRAVITY_M2 / total_mass, tangent));
+    body_set_velocity(mass2, vec_multiply(GRAVITY_M1 / total_mass, tangent));
+    return (Scenario) {.scene = scene, .body1 = mass1, .body2 = mass2};
+}
+
+double gravity_energy(Scenario *s) {
+    Vector r = vec_subtract(body_get_centroid(s->body2), body_get_centroid(s->body1));
+    double potential = -GRAVITY_G * GRAVITY_M1 * GRAVITY_M2 / sqrt(vec_dot(r, r));
+    return potential + kinetic_energy(s->body1) + kinetic_energy(s->body2);
+}
+
+double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+int main(void) {
+    const ScenarioType scenarios[] = {
+        {"spring", spring_init, spring_energy, 100},
+        {"gravity", gravity_init, gravity_energy, 60},
+    };
+    const char *integrator_names[] = {"trapezoid", "symplectic_euler", "velocity_verlet", "rk4"};
+    const Integrator integrators[] = {
+        INTEGRATOR_TRAPEZOID, INTEGRATOR_SYMPLECTIC_EULER,
+        INTEGRATOR_VELOCITY_VERLET, INTEGRATOR_RK4
+    };
+    const double dts[] = {1e-3, 1e-2, 5e-2};
+
+    printf("%-8s %-17s %8s %8s %10s %12s\n",
+        "scenario", "integrator", "dt", "steps", "ns/step", "max drift");
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(*scenarios); s++) {
+        for (size_t i = 0; i < sizeof(integrators) / sizeof(*integrators); i++) {
+            for (size_t d = 0; d < sizeof(dts) / sizeof(*dts); d++) {
+                double dt = dts[d];
+                int steps = (int) (scenarios[s].duration / dt);
+
+                // Timed separately, so measuring the energy is not counted
+                Scenario timed = scenarios[s].init(integrators[i]);
+                double start = now_ns();
+                for (int step = 0; step < steps; step++) {
+                    scene_tick(timed.scene, dt);
+                }
+                double ns_per_step = (now_ns() - start) / steps;
+                scene_free(timed.scene);
+
+                Scenario measured = scenarios[s].init(integrators[i]);
+                double initial_energy = scenarios[s].energy(&measured);
+                double max_drift = 0;
+                for (int step = 0; step < steps; step++) {
+                    scene_tick(measured.scene, dt);
+                    double energy = scenarios[s].energy(&measured);
+                    max_drift = fmax(max_drift, fabs((energy - initial_energy) / initial_energy));
+                }
+                scene_free(measured.scene);
+
+                printf("%-8s %-17s %8g %8d %10.1f %12.3e\n",
+                    scenarios[s].name, integrator_names[i], dt, steps, ns_per_step, max_drift);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,357 @@
+#include "forces.h"
+#include "polygon_helper.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures the throughput of scene_tick() on scenes of growing size,
+// printing one JSON object per run so results can be compared across commits.
+//
+// Usage: bench_physics [scenario n [m [ticks]]]
+// With no arguments, every scenario is run at a few sizes.
+// Each run happens in its own process, so its peak RSS is its own.
+
+#define DT 1e-2
+// Ticks run before timing starts, so caches and arrays have warmed up
+#define WARMUP_TICKS 10
+#define WORLD_SIZE 1000.0
+#define BODY_RADIUS 1
+
+// The gravitygod obstacle stream, from gravitygod.c
+#define STREAM_WIDTH 80.0
+#define STREAM_SPEED 25
+#define STREAM_STARS 30
+#define OBSTACLE_WIDTH 5
+#define OBSTACLE_HEIGHT 10
+#define PLAYER_WIDTH 9
+#define PLAYER_HEIGHT 20
+#define PLAYER_GRAVITY 100
+
+#define BLACK ((RGBColor) {0, 0, 0})
+
+// The calls to malloc(), calloc() and realloc() made so far.
+// The bench is linked with --wrap for each of them (see the Makefile).
+size_t allocations = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    allocations++;
+    return __real_realloc(ptr, size);
+}
+
+typedef struct {
+    const char *name;
+    // Builds the scenario's scene; m is ignored by scenarios with one size
+    Scene *(*init)(size_t n, size_t m);
+    // If non-NULL, called before every tick, e.g. to spawn bodies
+    void (*before_tick)(Scene *scene, size_t tick);
+} ScenarioType;
+
+typedef struct {
+    const ScenarioType *type;
+    size_t n;
+    size_t m;
+    size_t ticks;
+} Run;
+
+double random_between(double min, double max) {
+    return min + (max - min) * rand() / RAND_MAX;
+}
+
+Vector random_position(void) {
+    return (Vector) {random_between(0, WORLD_SIZE), random_between(0, WORLD_SIZE)};
+}
+
+Body *add_body(Scene *scene, Shape *shape, double mass, Vector position, Vector velocity) {
+    Body *body = body_init_with_shape(shape, mass, BLACK, NULL, NULL);
+    body_set_centroid(body, position);
+    body_set_velocity(body, velocity);
+    scene_add_body(scene, body);
+    return body;
+}
+
+// n bodies moving freely, with no force creators
+Scene *free_bodies_init(size_t n, size_t m) {
+    Scene *scene = scene_init();
+    Shape *shape = shape_init(rectangle_points(VEC_ZERO, 2 * BODY_RADIUS, 2 * BODY_RADIUS));
+    for (size_t i = 0; i < n; i++) {
+        Vector velocity = {random_between(-10, 10), random_between(-10, 10)};
+        add_body(scene, shape, 1, random_position(), velocity);
+    }
+    shape_release(shape);
+    return scene;
+}
+
+// n balls falling through a row of m walls, with a contact between every ball
+// and every wall, so n * m pairs are tested each tick
+Scene *collision_pairs_init(size_t n, size_t m) {
+    Scene *scene = scene_init();
+    Shape *ball = shape_init(ellipse_points(VEC_ZERO, 16, BODY_RADIUS, BODY_RADIUS));
+    Shape *wall = shape_init(rectangle_points(VEC_ZERO, 4 * BODY_RADIUS, BODY_RADIUS));
+    Body *walls[m];
+    for (size_t j = 0; j < m; j++) {
+        Vector position = {WORLD_SIZE * (j + 0.5) / m, 0};
+        walls[j] = add_body(scene, wall, INFINITY, position, VEC_ZERO);
+        body_set_type(walls[j], BODY_STATIC);
+    }
+    for (size_t i = 0; i < n; i++) {
+        Vector position = {WORLD_SIZE * (i + 0.5) / n, random_between(5, 20)};
+        Body *body = add_body(scene, ball, 1, position, (Vector) {0, -20});
+        for (size_t j = 0; j < m; j++) {
+            create_physics_collision(scene, 0.5, body, walls[j]);
+        }
+    }
+    shape_release(ball);
+    shape_release(wall);
+    return scene;
+}
+
+// A chain of n bodies joined by springs, hanging from a fixed anchor
+Scene *spring_chain_init(size_t n, size_t m) {
+    Scene *scene = scene_init();
+    Shape *shape = shape_init(rectangle_points(VEC_ZERO, 2 * BODY_RADIUS, 2 * BODY_RADIUS));
+    Body *previous = add_body(scene, shape, INFINITY, VEC_ZERO, VEC_ZERO);
+    for (size_t i = 0; i < n; i++) {
+        Vector position = {(i + 1) * 3.0, random_between(-1, 1)};
+        Body *body = add_body(scene, shape, 1, position, VEC_ZERO);
+        create_spring(scene, 100, previous, body);
+        previous = body;
+    }
+    shape_release(shape);
+    return scene;
+}
+
+// n bodies attracting each other, in one gravity group
+Scene *n_body_init(size_t n, size_t m) {
+    Scene *scene = scene_init();
+    Shape *shape = shape_init(rectangle_points(VEC_ZERO, 2 * BODY_RADIUS, 2 * BODY_RADIUS));
+    GravityGroup *group = create_gravity_group(scene, 1, 0.5);
+    for (size_t i = 0; i < n; i++) {
+        gravity_group_add(group, add_body(scene, shape, 1, random_position(), VEC_ZERO));
+    }
+    shape_release(shape);
+    return scene;
+}
+
+// The state of the obstacle stream, which is rebuilt by each run's process
+typedef struct {
+    Body *player;
+    Shape *obstacle_shape;
+    GravityField gravity;
+    // Obstacles are spawned every this many ticks
+    size_t spawn_interval;
+    size_t hits;
+} ObstacleStream;
+
+ObstacleStream stream;
+
+void count_hit(Body *player, Body *obstacle, Vector axis, void *aux) {
+    ((ObstacleStream *) aux)->hits++;
+}
+
+// gravitygod's game loop without the rendering: a player between the floor
+// and the ceiling, background stars, and kinematic obstacles streaming past,
+// with about n obstacles on screen at once
+Scene *obstacle_stream_init(size_t n, size_t m) {
+    Scene *scene = scene_init();
+    Shape *star = shape_init(polygon_points(VEC_ZERO, 4, BODY_RADIUS, 2.5));
+    for (size_t i = 0; i < STREAM_STARS; i++) {
+        Vector position = {random_between(0, STREAM_WIDTH), random_between(0, STREAM_WIDTH)};
+        Body *body = add_body(scene, star, 10, position, (Vector) {-STREAM_SPEED, 0});
+        body_set_type(body, BODY_KINEMATIC);
+    }
+    shape_release(star);
+
+    Shape *player = shape_init(rectangle_points(VEC_ZERO, PLAYER_WIDTH, PLAYER_HEIGHT));
+    stream.player = add_body(scene, player, 100, (Vector) {10, STREAM_WIDTH / 2}, VEC_ZERO);
+    shape_release(player);
+    create_half_plane(scene, VEC_ZERO, (Vector) {0, 1}, 0, stream.player);
+    create_half_plane(scene, (Vector) {0, STREAM_WIDTH - 6}, (Vector) {0, -1}, 0, stream.player);
+    stream.gravity.acceleration = (Vector) {0, -PLAYER_GRAVITY};
+    create_uniform_gravity(scene, &stream.gravity, stream.player);
+
+    stream.obstacle_shape = shape_init(rectangle_points(VEC_ZERO, OBSTACLE_WIDTH, OBSTACLE_HEIGHT));
+    size_t crossing_ticks = (size_t) (STREAM_WIDTH / STREAM_SPEED / DT);
+    stream.spawn_interval = n < crossing_ticks ? crossing_ticks / n : 1;
+    stream.hits = 0;
+    return scene;
+}
+
+void obstacle_stream_before_tick(Scene *scene, size_t tick) {
+    // Flip gravity now and then, as the player would
+    if (tick % 100 == 0) {
+        stream.gravity.acceleration.y *= -1;
+    }
+    if (tick % stream.spawn_interval == 0) {
+        double y = rand() % 2 == 0 ? OBSTACLE_HEIGHT / 2 : STREAM_WIDTH - OBSTACLE_HEIGHT / 2;
+        Body *obstacle = add_body(
+            scene, stream.obstacle_shape, INFINITY,
+            (Vector) {STREAM_WIDTH, y}, (Vector) {-STREAM_SPEED, 0}
+        );
+        body_set_type(obstacle, BODY_KINEMATIC);
+        create_collision(scene, stream.player, obstacle, count_hit, &stream, NULL);
+    }
+    size_t bodies = scene_bodies(scene);
+    for (size_t i = 0; i < bodies; i++) {
+        Body *body = scene_get_body(scene, i);
+        Vector position = body_get_centroid(body);
+        if (position.x < -OBSTACLE_WIDTH) {
+            if (body_get_mass(body) == INFINITY) {
+                body_remove(body);
+            }
+            else {
+                body_set_centroid(body, (Vector) {STREAM_WIDTH, position.y});
+            }
+        }
+    }
+}
+
+const ScenarioType SCENARIOS[] = {
+    {"free_bodies", free_bodies_init, NULL},
+    {"collision_pairs", collision_pairs_init, NULL},
+    {"spring_chain", spring_chain_init, NULL},
+    {"n_body", n_body_init, NULL},
+    {"obstacle_stream", obstacle_stream_init, obstacle_stream_before_tick},
+};
+
+const ScenarioType *find_scenario(const char *name) {
+    for (size_t i = 0; i < sizeof(SCENARIOS) / sizeof(*SCENARIOS); i++) {
+        if (strcmp(SCENARIOS[i].name, name) == 0) {
+            return &SCENARIOS[i];
+        }
+    }
+    return NULL;
+}
+
+double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// Runs one scenario and prints its results as a JSON object,
+// preceded by a separator unless it is the first result
+void run_benchmark(Run run, bool first) {
+    srand(1);
+    Scene *scene = run.type->init(run.n, run.m);
+    size_t tick = 0;
+    for (; tick < WARMUP_TICKS; tick++) {
+        if (run.type->before_tick != NULL) {
+            run.type->before_tick(scene, tick);
+        }
+        scene_tick(scene, DT);
+    }
+
+    size_t body_ticks = 0;
+    size_t start_allocations = allocations;
+    double start = now_ns();
+    for (; tick < WARMUP_TICKS + run.ticks; tick++) {
+        if (run.type->before_tick != NULL) {
+            run.type->before_tick(scene, tick);
+        }
+        body_ticks += scene_bodies(scene);
+        scene_tick(scene, DT);
+    }
+    double elapsed = now_ns() - start;
+    size_t tick_allocations = allocations - start_allocations;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf(
+        "%s    {\"scenario\": \"%s\", \"n\": %zu, \"m\": %zu, \"ticks\": %zu, "
+        "\"bodies\": %zu, \"ns_per_tick\": %.1f, \"bodies_per_sec\": %.4g, "
+        "\"allocs_per_tick\": %.2f, \"peak_rss_kb\": %ld}",
+        first ? "" : ",\n", run.type->name, run.n, run.m, run.ticks,
+        scene_bodies(scene), elapsed / run.ticks, body_ticks / (elapsed / 1e9),
+        (double) tick_allocations / run.ticks, usage.ru_maxrss
+    );
+    scene_free(scene);
+}
+
+// Runs a scenario in a child process; returns whether it succeeded
+bool run_in_child(Run run, bool first) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        run_benchmark(run, first);
+        fflush(stdout);
+        _exit(0);
+    }
+    int status;
+    return pid > 0 && waitpid(pid, &status, 0) == pid
+        && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    const Run default_runs[] = {
+        {&SCENARIOS[0], 1000, 0, 1000},
+        {&SCENARIOS[0], 10000, 0, 200},
+        {&SCENARIOS[1], 10, 10, 500},
+        {&SCENARIOS[1], 40, 40, 200},
+        {&SCENARIOS[2], 100, 0, 1000},
+        {&SCENARIOS[2], 1000, 0, 200},
+        {&SCENARIOS[3], 100, 0, 500},
+        {&SCENARIOS[3], 1000, 0, 100},
+        {&SCENARIOS[3], 10000, 0, 20},
+        {&SCENARIOS[4], 2, 0, 2000},
+        {&SCENARIOS[4], 50, 0, 2000},
+    };
+    const Run *runs = default_runs;
+    size_t run_count = sizeof(default_runs) / sizeof(*default_runs);
+
+    Run custom_run;
+    if (argc > 1) {
+        custom_run.type = find_scenario(argv[1]);
+        if (custom_run.type == NULL || argc < 3) {
+            fprintf(stderr, "usage: %s [scenario n [m [ticks]]]\nscenarios:", argv[0]);
+            for (size_t i = 0; i < sizeof(SCENARIOS) / sizeof(*SCENARIOS); i++) {
+                fprintf(stderr, " %s", SCENARIOS[i].name);
+            }
+            fprintf(stderr, "\n");
+            return 1;
+        }
+        custom_run.n = strtoul(argv[2], NULL, 10);
+        custom_run.m = argc > 3 ? strtoul(argv[3], NULL, 10) : custom_run.n;
+        custom_run.ticks = argc > 4 ? strtoul(argv[4], NULL, 10) : 100;
+        if (custom_run.n == 0 || custom_run.ticks == 0) {
+            fprintf(stderr, "n and ticks must be positive\n");
+            return 1;
+        }
+        runs = &custom_run;
+        run_count = 1;
+    }
+
+    printf("{\"benchmark\": \"physics\", \"dt\": %g, \"results\": [\n", DT);
+    bool ok = true;
+    // Whether no result has been printed yet, so the next needs no separator
+    bool first = true;
+    for (size_t i = 0; i < run_count; i++) {
+        if (run_in_child(runs[i], first)) {
+            first = false;
+        }
+        else {
+            fprintf(stderr, "%s %zu failed\n", runs[i].type->name, runs[i].n);
+            ok = false;
+        }
+    }
+    printf("\n]}\n");
+    return ok ? 0 : 1;
+}
@@ -8,10 +8,12 @@
 #include "include/scene.h"
 #include "include/body.h"
 #include "include/polygon_helper.h"
+#include "include/shape.h"
 #include "include/forces.h"
 #include "include/color.h"
 #include "include/vector.h"
 #include "include/sdl_wrapper.h"
+#include "include/alloc_tracker.h"
 
 // Window constants
 #define WINDOW_MAX ((Vector) {.x = 80.0, .y = 80.0})
@@ -49,6 +51,11 @@
 // Physics constants
 #define G 3e-10
 #define EARTH_MASS 7e14
+// The pull the old point-mass anchor had on a player halfway up the window
+#define GRAVITY_STRENGTH (G * EARTH_MASS / (WINDOW_MAX.y * WINDOW_MAX.y / 4))
+// Where the player lands when gravity pulls down or up
+#define FLOOR_HEIGHT 0
+#define CEILING_HEIGHT (WINDOW_MAX.y - 6)
 
 // Misc. constants
 #define BLACK ((RGBColor) {.r = 0, .g = 0, .b = 0})
@@ -72,6 +79,16 @@ typedef struct game_state {
   bool in_start_menu;
   Kind curr_player_type;
   Scene* scene;
+  Body *player;
+  // Pulls the player towards the floor or ceiling
+  GravityField gravity;
+  Gravity_Direction gravity_direction;
+  // Shapes shared by every obstacle and emoji
+  Shape *obstacle_shape;
+  Shape *emoji_shape;
+  // Textures shared by every emoji, loaded once
+  SDL_Texture *ring_texture;
+  SDL_Texture *peach_texture;
 } Game_State;
 
 // Player struct
@@ -96,103 +113,35 @@ void emoji_collision(Body *player, Body *emoji, Vector axis, void *aux) {
   gs->to_increment_score = true;
 }
 
-void hit_ground(Body *wall, Body *player, Vector axis, void *aux) {
-  Scene *scene = (Scene*)aux;
-
-  body_remove(wall);
-  Body *new_wall = body_init_with_info(body_get_shape(wall), EARTH_MASS, BACKGROUND_COLOR, (void*)Gravity, NULL);
-  scene_add_body(scene, new_wall);
-
-  scene_tick_delete_only(scene);
-  body_tick(player, 0); // To reset the forces active on the body
-  body_set_velocity(player, VEC_ZERO);
-}
-
-// Creates a gravitational force on the player in a given direction
-void create_gravity(Scene *scene, Gravity_Direction direction) {
-  Vector gravity_location = {.x = PLAYER_LOCATION.x, .y = 0};
+Vector gravity_acceleration(Gravity_Direction direction) {
   if (direction == Up) {
-    gravity_location.y = WINDOW_MAX.y - 5;
-  }
-  else {
-    gravity_location.y = -.5;
-  }
-  List *gravity_points = rectangle_points(gravity_location, 2, 2);
-  Body *gravity_body = body_init_with_info(gravity_points, EARTH_MASS, TRANSPARENT, (void*)Gravity, NULL);
-  scene_add_body(scene, gravity_body);
-
-  // Add force creators
-  Body *player;
-  for (size_t i = 0; i < scene_bodies(scene); i++) {
-    Body *b = scene_get_body(scene, i);
-    if (body_get_mass(b) == KANYE_MASS || body_get_mass(b) == ARIANA_MASS) {
-      player = b;
-    }
+    return (Vector){.x = 0, .y = GRAVITY_STRENGTH};
   }
-  create_newtonian_gravity(scene, G, gravity_body, player);
-  create_collision(scene, gravity_body, player, hit_ground, scene, NULL);
+  return (Vector){.x = 0, .y = -GRAVITY_STRENGTH};
 }
 
-void flip_gravity(Scene *scene) {
-  bool player_found = false;
-  bool gravity_existed = false;
-  Body *player;
+// Keeps the player between the floor and the ceiling,
+// and creates the gravitational field pulling the player towards one of them
+void create_gravity(Game_State *gs, Gravity_Direction direction) {
+  create_half_plane(gs->scene, (Vector){.x = 0, .y = FLOOR_HEIGHT}, (Vector){.x = 0, .y = 1}, 0, gs->player);
+  create_half_plane(gs->scene, (Vector){.x = 0, .y = CEILING_HEIGHT}, (Vector){.x = 0, .y = -1}, 0, gs->player);
 
-  for (size_t i = 0; i < scene_bodies(scene); i++) {
-    Body *b = scene_get_body(scene, i);
-    Kind type = Emoji;
-    if (body_get_mass(b) == KANYE_MASS) {
-      type = Kanye;
-    }
-    else if (body_get_mass(b) == ARIANA_MASS) {
-      type = Ariana;
-    }
-    else if (body_get_mass(b) != EMOJI_MASS) {
-      type = (Kind)body_get_info(b);
-    }
-
-    if (!gravity_existed && type == Gravity) {
-      body_remove(b);
-
-      // Gravity previously pulled player down
-      if (body_get_centroid(b).y < WINDOW_MAX.y / 2) {
-        create_gravity(scene, Up);
-      }
-      // Gravity previously pulled player up
-      else {
-        create_gravity(scene, Down);
-      }
-
-      gravity_existed = true;
-    }
-    else if (!player_found && (type == Ariana || type == Kanye)) {
-      player = b;
-      player_found = true;
-    }
-
-    if (player_found && gravity_existed) {
-      break;
-    }
-  }
-
-  scene_tick_delete_only(scene);
-  body_tick(player, 0);
+  gs->gravity_direction = direction;
+  gs->gravity.acceleration = gravity_acceleration(direction);
+  create_uniform_gravity(gs->scene, &gs->gravity, gs->player);
+}
 
-  Vector curr_velocity = body_get_velocity(player);
-  if (curr_velocity.y < 0 || body_get_centroid(player).y < 10) {
-    body_set_velocity(player, (Vector){.x = 0, .y = PLAYER_INIT_FALL_SPEED});
-  }
-  else if (curr_velocity.y > 0 || body_get_centroid(player).y > WINDOW_MAX.y - 10) {
-    body_set_velocity(player, (Vector){.x = 0, .y = -PLAYER_INIT_FALL_SPEED});
-  }
+void flip_gravity(Game_State *gs) {
+  gs->gravity_direction = gs->gravity_direction == Down ? Up : Down;
+  gs->gravity.acceleration = gravity_acceleration(gs->gravity_direction);
 
-  /* Cause an assertion to fail if we tried flipping gravity
-   * when no gravity had ever been created or if we didn't create a player */
-  assert(gravity_existed && player_found);
+  // Push off towards the new direction of gravity
+  double fall_speed = gs->gravity_direction == Up ? PLAYER_INIT_FALL_SPEED : -PLAYER_INIT_FALL_SPEED;
+  body_set_velocity(gs->player, (Vector){.x = 0, .y = fall_speed});
 }
 
-char* concat(const char *a, const char *b) {
-    char *result = malloc(strlen(a) + strlen(b) + 1);
+char* concat(AllocTag tag, const char *a, const char *b) {
+    char *result = TAGGED_MALLOC(tag, strlen(a) + strlen(b) + 1);
     strcpy(result, a);
     strcat(result, b);
     return result;
@@ -204,19 +153,23 @@ Body *create_ariana(Vector location) {
   for (int i = 0; i < ANIMATION_FRAMES; i++) {
     char index[3];
     sprintf(index, "%d", i);
-    char *path = concat("images/ariana", index);
-    char *image_path = concat(path, ".png");
+    char *path = concat(ALLOC_RENDER, "images/ariana", index);
+    char *image_path = concat(ALLOC_RENDER, path, ".png");
     SDL_Texture *ariana_texture = sdl_load_image(image_path);
     list_add(textures, (void*)ariana_texture);
+    TRACKED_FREE(path);
+    TRACKED_FREE(image_path);
   }
 
   for (int i = 0; i < ANIMATION_FRAMES; i++) {
     char index[3];
     sprintf(index, "%d", i);
-    char *path = concat("images/ariana", index);
-    char *image_path = concat(path, "flipped.png");
+    char *path = concat(ALLOC_RENDER, "images/ariana", index);
+    char *image_path = concat(ALLOC_RENDER, path, "flipped.png");
     SDL_Texture *ariana_texture = sdl_load_image(image_path);
     list_add(textures, (void*)ariana_texture);
+    TRACKED_FREE(path);
+    TRACKED_FREE(image_path);
   }
 
   List *player_points = rectangle_points(location, COLLIDER_WIDTH, COLLIDER_HEIGHT);
@@ -230,19 +183,23 @@ Body *create_kanye(Vector location) {
   for (int i = 0; i < ANIMATION_FRAMES; i++) {
     char index[3];
     sprintf(index, "%d", i);
-    char *path = concat("images/kanye", index);
-    char *image_path = concat(path, ".png");
+    char *path = concat(ALLOC_RENDER, "images/kanye", index);
+    char *image_path = concat(ALLOC_RENDER, path, ".png");
     SDL_Texture *kanye_texture = sdl_load_image(image_path);
     list_add(textures, (void*)kanye_texture);
+    TRACKED_FREE(path);
+    TRACKED_FREE(image_path);
   }
 
   for (int i = 0; i < ANIMATION_FRAMES; i++) {
     char index[3];
     sprintf(index, "%d", i);
-    char *path = concat("images/kanye", index);
-    char *image_path = concat(path, "flipped.png");
+    char *path = concat(ALLOC_RENDER, "images/kanye", index);
+    char *image_path = concat(ALLOC_RENDER, path, "flipped.png");
     SDL_Texture *kanye_texture = sdl_load_image(image_path);
     list_add(textures, (void*)kanye_texture);
+    TRACKED_FREE(path);
+    TRACKED_FREE(image_path);
   }
 
   List *player_points = rectangle_points(location, COLLIDER_WIDTH, COLLIDER_HEIGHT);
@@ -251,15 +208,18 @@ Body *create_kanye(Vector location) {
 }
 
 void create_stars(Scene *scene) {
+  List *star_points = polygon_points(VEC_ZERO, SIDES_BACKGROUND_STARS, RADIUS_BACKGROUND_STARS, SLIMNESS_BACKGROUND_STARS);
+  Shape *star_shape = shape_init(star_points);
   for (int i = 0; i < NUM_STARS; i++) {
-    List *star_points = polygon_points(VEC_ZERO, SIDES_BACKGROUND_STARS, RADIUS_BACKGROUND_STARS, SLIMNESS_BACKGROUND_STARS);
-    Body *star = body_init_with_info(star_points, STAR_MASS, STAR_COLOR, (void*)Star, NULL);
+    Body *star = body_init_with_shape(star_shape, STAR_MASS, STAR_COLOR, (void*)Star, NULL);
     body_set_centroid(star, (Vector){.x = (double)random_int_between(0, (int)WINDOW_MAX.x),
       .y = (double)random_int_between(0, (int)WINDOW_MAX.y)});
       Vector star_vel = (Vector){.x = -1 * PLAYER_SPEED, .y = 0};
     body_set_velocity(star, star_vel);
+    body_set_type(star, BODY_KINEMATIC);
     scene_add_body(scene, star);
 }
+  shape_release(star_shape);
 }
 
 
@@ -279,19 +239,15 @@ Player *player_init(Kind type) {
   return player;
 }
 
-Body *create_ring(Vector location) {
-  char *image_path = "images/ring.png";
-  SDL_Texture *ring_texture = sdl_load_image(image_path);
-  List *ring_points = rectangle_points(location, EMOJI_SIZE, EMOJI_SIZE);
-  Body *ring = body_init_with_info(ring_points, EMOJI_MASS, BACKGROUND_COLOR, (void*)ring_texture, NULL);
+Body *create_ring(Shape *shape, SDL_Texture *ring_texture, Vector location) {
+  Body *ring = body_init_with_shape(shape, EMOJI_MASS, BACKGROUND_COLOR, (void*)ring_texture, NULL);
+  body_set_centroid(ring, location);
   return ring;
 }
 
-Body *create_peach(Vector location) {
-  char *image_path = "images/peach.png";
-  SDL_Texture *peach_texture = sdl_load_image(image_path);
-  List *peach_points = rectangle_points(location, EMOJI_SIZE, EMOJI_SIZE);
-  Body *peach = body_init_with_info(peach_points, EMOJI_MASS, BACKGROUND_COLOR, (void*)peach_texture, NULL);
+Body *create_peach(Shape *shape, SDL_Texture *peach_texture, Vector location) {
+  Body *peach = body_init_with_shape(shape, EMOJI_MASS, BACKGROUND_COLOR, (void*)peach_texture, NULL);
+  body_set_centroid(peach, location);
   return peach;
 }
 
@@ -306,13 +262,14 @@ void create_emoji(Player *player, Game_State *gs, int rand_seed) {
 
   Body *emoji;
   if (body_get_mass(player->body) == ARIANA_MASS) {
-    emoji = create_ring(location);
+    emoji = create_ring(gs->emoji_shape, gs->ring_texture, location);
   }
   else {
-    emoji = create_peach(location);
+    emoji = create_peach(gs->emoji_shape, gs->peach_texture, location);
   }
 
   body_set_velocity(emoji, (Vector){.x = -PLAYER_SPEED, .y = 0});
+  body_set_type(emoji, BODY_KINEMATIC);
   scene_add_body(gs->scene, emoji);
   create_collision(gs->scene, player->body, emoji, emoji_collision, gs, NULL);
 }
@@ -326,10 +283,11 @@ void create_obstacle(Player *player, Game_State *gs, int rand_seed) {
     location.y = OBSTACLE_HEIGHT / 2;
   }
 
-  List *points = rectangle_points(location, OBSTACLE_WIDTH, OBSTACLE_HEIGHT);
-  Body *obstacle = body_init_with_info(points, INFINITY, BLACK, (void*)Obstacle, NULL);
+  Body *obstacle = body_init_with_shape(gs->obstacle_shape, INFINITY, BLACK, (void*)Obstacle, NULL);
+  body_set_centroid(obstacle, location);
 
   body_set_velocity(obstacle, (Vector){.x = -PLAYER_SPEED, .y = 0});
+  body_set_type(obstacle, BODY_KINEMATIC);
   scene_add_body(gs->scene, obstacle);
   create_collision(gs->scene, player->body, obstacle, obstacle_collision, gs, NULL);
 }
@@ -345,11 +303,11 @@ gs->level_just_increased = false;
 }
 
 void on_key(char key, KeyEventType type, double held_time, void *aux) {
-  Scene *scene = (Scene*)aux;
+  Game_State *gs = (Game_State*)aux;
   if (type == KEY_PRESSED) {
     switch(key) {
       case ' ':
-        flip_gravity(scene);
+        flip_gravity(gs);
         break;
     }
   }
@@ -378,7 +336,7 @@ void on_key_endscreen(char key, KeyEventType type, double held_time, void *aux)
     switch(key) {
       case ' ':
         reset(gs);
-        sdl_on_key(on_key, gs->scene);
+        sdl_on_key(on_key, gs);
         break;
 
 
@@ -393,13 +351,15 @@ void show_endscreen_text(Player *player) {
   char *play = "Press space to play again!";
   sdl_show_text(275, 425, 300, 100, 1000, play, BLACK);
 
-  char *score = malloc(ENOUGH * sizeof(char));
+  char *score = TAGGED_MALLOC(ALLOC_TEXT, ENOUGH * sizeof(char));
   sprintf(score, "Score: %d", player->score);
   sdl_show_text(150, 100, 500, 200, 1000, score, BLACK);
+  TRACKED_FREE(score);
 
-  char *level = malloc(ENOUGH * sizeof(char));
+  char *level = TAGGED_MALLOC(ALLOC_TEXT, ENOUGH * sizeof(char));
   sprintf(level, "Level: %d", player->level);
   sdl_show_text(275, 300, 300, 100, 1000, level, BLACK);
+  TRACKED_FREE(level);
 }
 
 void draw_emojis(Scene *scene) {
@@ -499,22 +459,27 @@ void show_startmenu_text() {
 }
 
 SDL_Surface* new_score_level_surface(Player *p) {
-  char *score = malloc(ENOUGH * sizeof(char));
+  char *score = TAGGED_MALLOC(ALLOC_TEXT, ENOUGH * sizeof(char));
   sprintf(score, "Score: %d", p->score);
 
-  char *level = malloc(ENOUGH * sizeof(char));
+  char *level = TAGGED_MALLOC(ALLOC_TEXT, ENOUGH * sizeof(char));
   sprintf(level, "  Level: %d", p->level);
 
-  char *combined = concat(score, level);
+  char *combined = concat(ALLOC_TEXT, score, level);
   TTF_Font *font = TTF_OpenFont("fonts/SF Atarian System.ttf", FONT_SIZE);
   SDL_Color White = {255, 255, 255};
   SDL_Surface* surface = TTF_RenderText_Blended(font, combined, White);
+  TTF_CloseFont(font);
+  TRACKED_FREE(score);
+  TRACKED_FREE(level);
+  TRACKED_FREE(combined);
   return surface;
 }
 
 int main(int argc, char **argv) {
   // Initialize the scene, player, and game
   srand(time(NULL));
+  alloc_tracker_print_at_exit();
   sdl_init(VEC_ZERO, WINDOW_MAX);
   Scene *scene = scene_init();
 
@@ -523,6 +488,10 @@ int main(int argc, char **argv) {
   gs->scene = scene;
   gs->in_start_menu = true;
   gs->curr_player_type = Kanye;
+  gs->obstacle_shape = shape_init(rectangle_points(VEC_ZERO, OBSTACLE_WIDTH, OBSTACLE_HEIGHT));
+  gs->emoji_shape = shape_init(rectangle_points(VEC_ZERO, EMOJI_SIZE, EMOJI_SIZE));
+  gs->ring_texture = sdl_load_image("images/ring.png");
+  gs->peach_texture = sdl_load_image("images/peach.png");
 
   sdl_on_key(on_key_start_menu, gs);
   create_heads(scene);
@@ -543,15 +512,18 @@ int main(int argc, char **argv) {
   //sdl_init(VEC_ZERO, WINDOW_MAX);
   List *rectangle = rectangle_points((Vector){.x = WINDOW_MAX.x / 2, .y = WINDOW_MAX.y / 2}, WINDOW_MAX.x, WINDOW_MAX.y);
   Body *background = body_init(rectangle, 1, BACKGROUND_COLOR);
+  body_set_type(background, BODY_STATIC);
   scene_add_body(scene, background);
   create_stars(scene);
 
   Player *player = player_init(gs->curr_player_type);
-  sdl_on_key(on_key, scene);
+  gs->player = player->body;
+  sdl_on_key(on_key, gs);
   scene_add_body(scene, player->body);
-  create_gravity(scene, Down);
+  create_gravity(gs, Down);
 
   SDL_Surface *surface = new_score_level_surface(player);
+  SceneView view = sdl_scene_view();
 
   double object_timer = 0;
   double background_timer = 0;
@@ -582,6 +554,7 @@ int main(int argc, char **argv) {
 
   dt = time_since_last_tick();
       scene_tick(scene, dt);
+      scene_render(scene, &view, 1);
       if (temp_score != player->score) {
         SDL_FreeSurface(surface);
         surface = new_score_level_surface(player);
@@ -651,6 +624,10 @@ int main(int argc, char **argv) {
     }
   }
   scene_free(scene);
+  shape_release(gs->obstacle_shape);
+  shape_release(gs->emoji_shape);
+  SDL_DestroyTexture(gs->ring_texture);
+  SDL_DestroyTexture(gs->peach_texture);
   free(gs);
   free(player);
   sdl_quit();
@@ -0,0 +1,156 @@
+#ifndef __ALLOC_TRACKER_H__
+#define __ALLOC_TRACKER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * An opt-in record of the library's heap allocations, by subsystem.
+ *
+ * The library allocates with TRACKED_MALLOC(), TRACKED_CALLOC(),
+ * TRACKED_REALLOC() and TRACKED_FREE, which are plain malloc(), calloc(),
+ * realloc() and free() unless the library is built with -DTRACK_ALLOCATIONS
+ * (e.g. "make TRACK_ALLOCATIONS=1"). Each allocation is counted under the
+ * ALLOC_TAG of the file that made it, which a source file can set by
+ * defining ALLOC_TAG before including any headers. A file whose allocations
+ * belong to several subsystems can name the tag at each call instead,
+ * with TAGGED_MALLOC(), TAGGED_CALLOC() and TAGGED_REALLOC().
+ *
+ * Freeing tracked memory with plain free() is safe, but its live bytes are
+ * only released once the allocator hands out the same address again.
+ */
+typedef enum {
+  ALLOC_OTHER,
+  ALLOC_BODY,
+  ALLOC_SHAPE,
+  ALLOC_SCENE,
+  ALLOC_FORCER,
+  ALLOC_COLLISION,
+  ALLOC_RENDER,
+  ALLOC_TEXT,
+  ALLOC_TAG_COUNT
+} AllocTag;
+
+/**
+ * The allocations made under one tag (or all of them) since the program started.
+ */
+typedef struct {
+  /** The number of allocations, including reallocations */
+  size_t allocations;
+  /** The number of frees, including the old blocks of reallocations */
+  size_t frees;
+  /** The total number of bytes allocated */
+  size_t bytes;
+  /** The number of bytes allocated and not yet freed */
+  size_t live_bytes;
+  /** The most live bytes there have been at once */
+  size_t peak_live_bytes;
+} AllocStats;
+
+#ifndef ALLOC_TAG
+#define ALLOC_TAG ALLOC_OTHER
+#endif
+
+#ifdef TRACK_ALLOCATIONS
+#define TAGGED_MALLOC(tag, size) alloc_tracker_malloc(tag, size)
+#define TAGGED_CALLOC(tag, count, size) alloc_tracker_calloc(tag, count, size)
+#define TAGGED_REALLOC(tag, ptr, size) alloc_tracker_realloc(tag, ptr, size)
+// Not a function-like macro, so that it can also be used as a FreeFunc
+#define TRACKED_FREE alloc_tracker_free
+#else
+#define TAGGED_MALLOC(tag, size) malloc(size)
+#define TAGGED_CALLOC(tag, count, size) calloc(count, size)
+#define TAGGED_REALLOC(tag, ptr, size) realloc(ptr, size)
+#define TRACKED_FREE free
+#endif
+
+#define TRACKED_MALLOC(size) TAGGED_MALLOC(ALLOC_TAG, size)
+#define TRACKED_CALLOC(count, size) TAGGED_CALLOC(ALLOC_TAG, count, size)
+#define TRACKED_REALLOC(ptr, size) TAGGED_REALLOC(ALLOC_TAG, ptr, size)
+
+/**
+ * Allocates memory like malloc(), counting it under a tag.
+ *
+ * @param tag the subsystem the memory is for
+ * @param size the number of bytes to allocate
+ * @return the allocated memory, or NULL if it could not be allocated
+ */
+void *alloc_tracker_malloc(AllocTag tag, size_t size);
+
+/**
+ * Allocates zeroed memory like calloc(), counting it under a tag.
+ *
+ * @param tag the subsystem the memory is for
+ * @param count the number of elements to allocate
+ * @param size the size of each element
+ * @return the allocated memory, or NULL if it could not be allocated
+ */
+void *alloc_tracker_calloc(AllocTag tag, size_t count, size_t size);
+
+/**
+ * Resizes memory like realloc(). The old block is counted as freed
+ * under the tag it was allocated with, and the new one as allocated under tag.
+ *
+ * @param tag the subsystem the memory is for
+ * @param ptr the memory to resize, or NULL to allocate new memory
+ * @param size the new size in bytes
+ * @return the resized memory, or NULL if it could not be allocated
+ */
+void *alloc_tracker_realloc(AllocTag tag, void *ptr, size_t size);
+
+/**
+ * Frees memory like free(), releasing its live bytes from the tag
+ * it was allocated with. Memory that was not tracked is just freed.
+ *
+ * @param ptr the memory to free, or NULL
+ */
+void alloc_tracker_free(void *ptr);
+
+/**
+ * Gets whether the library was built with allocation tracking.
+ * If not, every tag's statistics stay 0.
+ *
+ * @return whether TRACK_ALLOCATIONS was defined
+ */
+bool alloc_tracker_enabled(void);
+
+/**
+ * Gets the statistics of one tag's allocations.
+ *
+ * @param tag the tag to look up
+ * @return the allocations counted under the tag
+ */
+AllocStats alloc_tracker_get(AllocTag tag);
+
+/**
+ * Gets the statistics of all tracked allocations together.
+ * The peak is of the total live bytes, not the sum of the tags' peaks.
+ *
+ * @return the allocations counted under every tag
+ */
+AllocStats alloc_tracker_total(void);
+
+/**
+ * Gets the name of a tag, e.g. "body" for ALLOC_BODY.
+ *
+ * @param tag the tag to name
+ * @return the name, which must not be freed
+ */
+const char *alloc_tracker_tag_name(AllocTag tag);
+
+/**
+ * Prints a table of every tag's statistics and the total.
+ *
+ * @param file where to print the table, e.g. stderr
+ */
+void alloc_tracker_print(FILE *file);
+
+/**
+ * Prints the table from alloc_tracker_print() to stderr when the program exits,
+ * if tracking is enabled. Calling this more than once has no further effect.
+ */
+void alloc_tracker_print_at_exit(void);
+
+#endif // #ifndef __ALLOC_TRACKER_H__
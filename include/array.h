@@ -0,0 +1,194 @@
+#ifndef __ARRAY_H__
+#define __ARRAY_H__
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc_tracker.h"
+
+#define ARRAY_MIN_CAPACITY 4
+
+/**
+ * Declares a growable array whose element type is fixed at compile time.
+ * Unlike List, elements are stored by value in one contiguous block,
+ * and the array itself is a plain struct that can be embedded in other structs.
+ *
+ * For example, DEFINE_ARRAY(VectorArray, vector_array, Vector) declares
+ * typedef struct { Vector *data; size_t size; size_t capacity; } VectorArray;
+ * along with vector_array_init(), vector_array_add(), and so on.
+ *
+ * All the functions are static inline, so each array type costs nothing
+ * in the translation units that do not use it.
+ *
+ * @param Name the name of the array type to declare
+ * @param prefix the prefix of the functions operating on the array
+ * @param T the element type
+ */
+#define DEFINE_ARRAY(Name, prefix, T) \
+typedef struct { \
+  T *data; \
+  size_t size; \
+  size_t capacity; \
+} Name; \
+\
+/* Initializes an empty array with space for the given number of elements. */ \
+static inline void prefix##_init(Name *array, size_t capacity) { \
+  array->data = capacity > 0 ? TRACKED_MALLOC(capacity * sizeof(T)) : NULL; \
+  assert(capacity == 0 || array->data); \
+  array->size = 0; \
+  array->capacity = capacity; \
+} \
+\
+/* Releases the array's storage. Does not free anything the elements refer to. */ \
+static inline void prefix##_free(Name *array) { \
+  TRACKED_FREE(array->data); \
+  array->data = NULL; \
+  array->size = 0; \
+  array->capacity = 0; \
+} \
+\
+/* Makes sure the array can hold at least the given number of elements. */ \
+static inline void prefix##_reserve(Name *array, size_t capacity) { \
+  if (capacity <= array->capacity) { \
+    return; \
+  } \
+  T *data = TRACKED_REALLOC(array->data, capacity * sizeof(T)); \
+  assert(data); \
+  array->data = data; \
+  array->capacity = capacity; \
+} \
+\
+/* Releases any capacity beyond the array's current size. */ \
+static inline void prefix##_shrink(Name *array) { \
+  if (array->size == 0) { \
+    prefix##_free(array); \
+    return; \
+  } \
+  T *data = TRACKED_REALLOC(array->data, array->size * sizeof(T)); \
+  assert(data); \
+  array->data = data; \
+  array->capacity = array->size; \
+} \
+\
+static inline void prefix##_grow(Name *array, size_t needed) { \
+  size_t capacity = array->capacity < ARRAY_MIN_CAPACITY \
+    ? ARRAY_MIN_CAPACITY : array->capacity; \
+  while (capacity < needed) { \
+    capacity *= 2; \
+  } \
+  prefix##_reserve(array, capacity); \
+} \
+\
+static inline size_t prefix##_size(const Name *array) { \
+  return array->size; \
+} \
+\
+static inline T prefix##_get(const Name *array, size_t index) { \
+  assert(index < array->size); \
+  return array->data[index]; \
+} \
+\
+/* Returns a pointer to an element, valid until the array next grows. */ \
+static inline T *prefix##_at(Name *array, size_t index) { \
+  assert(index < array->size); \
+  return &array->data[index]; \
+} \
+\
+static inline void prefix##_set(Name *array, size_t index, T value) { \
+  assert(index < array->size); \
+  array->data[index] = value; \
+} \
+\
+/* Appends an element, growing the array geometrically if needed. */ \
+static inline void prefix##_add(Name *array, T value) { \
+  if (array->size >= array->capacity) { \
+    prefix##_grow(array, array->size + 1); \
+  } \
+  array->data[array->size] = value; \
+  array->size++; \
+} \
+\
+/* Appends count elements copied from values. */ \
+static inline void prefix##_append(Name *array, const T *values, size_t count) { \
+  if (count == 0) { \
+    return; \
+  } \
+  if (array->size + count > array->capacity) { \
+    prefix##_grow(array, array->size + count); \
+  } \
+  memcpy(&array->data[array->size], values, count * sizeof(T)); \
+  array->size += count; \
+} \
+\
+/* Removes an element, shifting the following elements down. O(n). */ \
+static inline T prefix##_remove(Name *array, size_t index) { \
+  assert(index < array->size); \
+  T element = array->data[index]; \
+  memmove( \
+    &array->data[index], &array->data[index + 1], \
+    (array->size - index - 1) * sizeof(T) \
+  ); \
+  array->size--; \
+  return element; \
+} \
+\
+/* Removes an element by moving the last element into its place. O(1). */ \
+static inline T prefix##_swap_remove(Name *array, size_t index) { \
+  assert(index < array->size); \
+  T element = array->data[index]; \
+  array->size--; \
+  array->data[index] = array->data[array->size]; \
+  return element; \
+} \
+\
+/* \
+ * Removes every element for which should_remove returns true, in one pass. \
+ * If freer is non-NULL, it is called on each removed element first. \
+ * If stable is false, holes are filled from the end of the array instead. \
+ * Returns the number of elements removed. \
+ */ \
+static inline size_t prefix##_remove_if( \
+    Name *array, bool (*should_remove)(T *), void (*freer)(T *), bool stable \
+) { \
+  size_t old_size = array->size; \
+  if (stable) { \
+    size_t kept = 0; \
+    for (size_t i = 0; i < array->size; i++) { \
+      if (should_remove(&array->data[i])) { \
+        if (freer != NULL) { \
+          freer(&array->data[i]); \
+        } \
+      } \
+      else { \
+        if (kept != i) { \
+          array->data[kept] = array->data[i]; \
+        } \
+        kept++; \
+      } \
+    } \
+    array->size = kept; \
+  } \
+  else { \
+    size_t i = 0; \
+    while (i < array->size) { \
+      if (should_remove(&array->data[i])) { \
+        if (freer != NULL) { \
+          freer(&array->data[i]); \
+        } \
+        prefix##_swap_remove(array, i); \
+      } \
+      else { \
+        i++; \
+      } \
+    } \
+  } \
+  return old_size - array->size; \
+} \
+\
+static inline void prefix##_clear(Name *array) { \
+  array->size = 0; \
+}
+
+#endif // #ifndef __ARRAY_H__
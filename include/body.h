@@ -3,18 +3,52 @@
 
 #include <stdbool.h>
 
+#include "array.h"
 #include "color.h"
 #include "list.h"
+#include "shape.h"
 #include "vector.h"
 
 /**
  * A rigid body constrained to the plane.
  * Implemented as a polygon with uniform density.
+ * The polygon is stored once relative to the body's centroid, along with the
+ * body's position and rotation, so moving a body takes constant time.
+ * World-space vertices are only computed when they are asked for.
  * Bodies can accumulate forces and impulses during each tick.
  * Angular physics (i.e. torques) are not currently implemented.
  */
 typedef struct body Body;
 
+/**
+ * How a body is moved by scene_tick().
+ * The type should be chosen before the body is added to a scene,
+ * since the scene keeps bodies of each type in a separate list.
+ */
+typedef enum {
+  /** Moved by the forces and impulses applied to it (the default) */
+  BODY_DYNAMIC,
+  /**
+   * Moves at a constant velocity, changed only by body_set_velocity().
+   * Forces and impulses applied to a kinematic body are ignored,
+   * so it can collide with dynamic bodies without being pushed by them.
+   */
+  BODY_KINEMATIC,
+  /**
+   * Never moves on its own, and ignores forces and impulses.
+   * Scenes skip static bodies entirely when ticking, but they still
+   * take part in collisions and are still drawn.
+   * Use this for backgrounds, walls, and fixed anchors.
+   */
+  BODY_STATIC
+} BodyType;
+
+/**
+ * A growable array of body pointers.
+ * See DEFINE_ARRAY() in array.h for the functions it provides.
+ */
+DEFINE_ARRAY(BodyArray, body_array, Body *)
+
 /**
  * Initializes a body without any info.
  * Acts like body_init_with_info() where info and info_freer are NULL.
@@ -26,7 +60,8 @@ Body *body_init(List *shape, double mass, RGBColor color);
  * The body is initially at rest.
  * Asserts that the mass is positive and that the required memory is allocated.
  *
- * @param shape a list of vectors describing the initial shape of the body
+ * @param shape a list of vectors describing the initial shape of the body.
+ *   The vertices are copied into the body, and the list is freed.
  * @param mass the mass of the body (if INFINITY, prevents the body from moving)
  * @param color the color of the body, used to draw it on the screen
  * @param info additional information to associate with the body,
@@ -38,6 +73,23 @@ Body *body_init_with_info(
     List *shape, double mass, RGBColor color, void *info, FreeFunc info_freer
 );
 
+/**
+ * Allocates memory for a body whose polygon is a shared shape.
+ * Many bodies can be created from the same shape without copying it.
+ * The body starts out centered at the shape's centroid, and at rest.
+ *
+ * @param shape the shape of the body. The body takes its own reference,
+ *   so the caller can release theirs once they are done creating bodies.
+ * @param mass the mass of the body (if INFINITY, prevents the body from moving)
+ * @param color the color of the body, used to draw it on the screen
+ * @param info additional information to associate with the body
+ * @param info_freer if non-NULL, a function call on the info to free it
+ * @return a pointer to the newly allocated body
+ */
+Body *body_init_with_shape(
+    Shape *shape, double mass, RGBColor color, void *info, FreeFunc info_freer
+);
+
 /**
  * Releases the memory allocated for a body.
  *
@@ -54,6 +106,69 @@ void body_free(Body *body);
  */
 List *body_get_shape(Body *body);
 
+/**
+ * Gets the current vertices of a body without copying them.
+ * The vertices are recomputed from the body's position and rotation
+ * if it has moved since they were last asked for.
+ * The array belongs to the body and must not be modified or freed;
+ * it is only valid until the body is next moved, rotated, or freed.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the polygon describing the body's current position
+ */
+const VectorArray *body_get_vertices(Body *body);
+
+/**
+ * Gets the unit normals of a body's edges in their current orientation.
+ * Normal i belongs to the edge starting at vertex i of body_get_vertices().
+ * The normals are cached, and only recomputed when the body has been rotated,
+ * so repeated collision tests do not need any trigonometry or square roots.
+ * The array belongs to the body and must not be modified or freed.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's outward edge normals
+ */
+const VectorArray *body_get_normals(Body *body);
+
+/**
+ * Gets the axis-aligned bounding box of a body's current vertices.
+ * Cached along with the vertices returned by body_get_vertices().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param min set to the bottom left corner of the box
+ * @param max set to the top right corner of the box
+ */
+void body_get_bounds(Body *body, Vector *min, Vector *max);
+
+/**
+ * Gets the shape a body was created from.
+ * Its vertices are relative to the body's centroid and ignore its rotation.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's shape, which is still owned by the body
+ */
+Shape *body_get_prototype(Body *body);
+
+/**
+ * Remembers a body's current position and rotation,
+ * so it can be drawn part of the way between them and where it moves next.
+ * scene_tick() calls this on every body that can move (dynamic bodies that
+ * are awake, and kinematic bodies) before moving any of them.
+ *
+ * @param body a pointer to a body returned from body_init()
+ */
+void body_save_state(Body *body);
+
+/**
+ * Computes a body's world-space vertices at a position and rotation
+ * interpolated between its saved state (see body_save_state()) and its current one.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param alpha how far to interpolate: 0 for the saved state, 1 for the current one
+ * @param vertices an array to fill with the vertices, replacing its contents
+ */
+void body_get_interpolated_vertices(Body *body, double alpha, VectorArray *vertices);
+
 /**
  * Gets the current center of mass of a body.
  * While this could be calculated with polygon_centroid(), that becomes too slow
@@ -73,6 +188,14 @@ Vector body_get_centroid(Body *body);
  */
 Vector body_get_velocity(Body *body);
 
+/**
+ * Gets the current orientation of a body.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the angle last passed to body_set_rotation(), or 0 if none was
+ */
+double body_get_rotation(Body *body);
+
 /**
  * Gets the mass of a body.
  *
@@ -124,6 +247,23 @@ void body_set_velocity(Body *body, Vector v);
  */
 void body_set_rotation(Body *body, double angle);
 
+/**
+ * Gets how a body is moved.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's type
+ */
+BodyType body_get_type(Body *body);
+
+/**
+ * Changes how a body is moved.
+ * Must be called before the body is added to a scene.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param type the body's new type
+ */
+void body_set_type(Body *body, BodyType type);
+
 /**
  * Applies a force to a body over the current tick.
  * If multiple forces are applied in the same tick, they should be added.
@@ -159,6 +299,194 @@ void body_add_impulse(Body *body, Vector impulse);
  */
 void body_tick(Body *body, double dt);
 
+/**
+ * Gets the total force applied to a body so far this tick.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the sum of the forces passed to body_add_force() since the last tick
+ */
+Vector body_get_force(Body *body);
+
+/**
+ * Gets the total impulse applied to a body so far this tick.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the sum of the impulses passed to body_add_impulse() since the last tick
+ */
+Vector body_get_impulse(Body *body);
+
+/**
+ * Replaces the force and impulse accumulated on a body.
+ * Lets a scene undo the effects of running a force creator a second time.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param force the body's new accumulated force
+ * @param impulse the body's new accumulated impulse
+ */
+void body_set_accumulated(Body *body, Vector force, Vector impulse);
+
+/**
+ * Applies the impulses accumulated on a body to its velocity,
+ * and returns the acceleration caused by the accumulated forces.
+ * Resets the forces and impulses accumulated on the body.
+ * Useful for integrators that need the acceleration at several points in a step.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the acceleration of the body due to its forces
+ */
+Vector body_take_acceleration(Body *body);
+
+/**
+ * Updates a body using the semi-implicit (symplectic) Euler method:
+ * the velocity is updated first, and the body moves at the new velocity.
+ * Cheaper than body_tick(), and keeps the energy of oscillating systems
+ * bounded instead of letting it drift.
+ * Non-dynamic bodies are ticked with body_tick().
+ *
+ * @param body the body to tick
+ * @param dt the number of seconds elapsed since the last tick
+ */
+void body_tick_symplectic_euler(Body *body, double dt);
+
+/**
+ * Updates a body using the Velocity Verlet method.
+ * The body moves by v dt + a dt^2 / 2, and its velocity is predicted as
+ * v + a dt. The prediction is corrected on the next tick, once the
+ * acceleration at the end of this step is known,
+ * so it must be ticked the same way every time to be second-order accurate.
+ * Non-dynamic bodies are ticked with body_tick().
+ *
+ * @param body the body to tick
+ * @param dt the number of seconds elapsed since the last tick
+ */
+void body_tick_verlet(Body *body, double dt);
+
+/**
+ * Sets how strongly a body is slowed down by the medium it moves through,
+ * which is also how create_drag() applies its drag.
+ * The damping force is -(linear + quadratic * |v|) v.
+ * It is applied by scene_tick() while integrating the body,
+ * either as a force or as exact decay (see scene_set_exact_damping()).
+ * Bodies start with no damping.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param linear the damping proportional to the body's velocity
+ * @param quadratic the damping proportional to the square of its speed
+ */
+void body_set_damping(Body *body, double linear, double quadratic);
+
+/**
+ * Gets the linear damping of a body. See body_set_damping().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's linear damping coefficient
+ */
+double body_get_linear_damping(Body *body);
+
+/**
+ * Gets the quadratic damping of a body. See body_set_damping().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's quadratic damping coefficient
+ */
+double body_get_quadratic_damping(Body *body);
+
+/**
+ * Gets whether a body has any damping, so callers can skip damping it.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return whether the linear or quadratic damping is nonzero
+ */
+bool body_has_damping(Body *body);
+
+/**
+ * Gets the damping force on a body at its current velocity.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return -(linear + quadratic * |v|) v, or 0 for infinite masses
+ */
+Vector body_get_damping_force(Body *body);
+
+/**
+ * Slows a body down by exactly as much as its damping alone would
+ * over a given time interval. The speed solves ds/dt = -(a s + b s^2)
+ * with a and b the damping coefficients divided by the mass,
+ * so it decays exponentially with only linear damping.
+ * Unlike applying the damping force, this can never reverse the velocity,
+ * however large the damping or the time interval.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param dt the time interval
+ */
+void body_apply_damping(Body *body, double dt);
+
+/**
+ * Moves a kinematic body at its current velocity for a given time interval.
+ * Much cheaper than body_tick(), since no forces or impulses are integrated;
+ * any that were applied to the body are discarded.
+ * body_tick() calls this for kinematic bodies, but scenes call it directly.
+ *
+ * @param body the body to tick
+ * @param dt the number of seconds elapsed since the last tick
+ */
+void body_tick_kinematic(Body *body, double dt);
+
+/**
+ * Updates how long a body has been moving slower than a given speed.
+ * Scenes use this to decide when bodies can be put to sleep.
+ * Does nothing to a sleeping body.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param max_speed the speed the body must stay below to count as resting
+ * @param dt the number of seconds elapsed since the last update
+ * @return the number of seconds the body has been resting
+ */
+double body_update_rest_time(Body *body, double max_speed, double dt);
+
+/**
+ * Puts a body to sleep: it is stopped, and scenes stop ticking it
+ * until it is woken up again. Its state is saved (see body_save_state()),
+ * so it is drawn where it stopped while it sleeps.
+ *
+ * @param body a pointer to a body returned from body_init()
+ */
+void body_sleep(Body *body);
+
+/**
+ * Wakes up a sleeping body, and restarts its rest time.
+ * Bodies are also woken up automatically when a force or impulse is
+ * applied to them, or when their position or velocity is changed.
+ *
+ * @param body a pointer to a body returned from body_init()
+ */
+void body_wake(Body *body);
+
+/**
+ * Returns whether a body is sleeping.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return true if body_sleep() was called and the body has not woken up since
+ */
+bool body_is_asleep(Body *body);
+
+/**
+ * Records where a scene keeps a body, so the scene can look it up in
+ * constant time while building its sleeping islands.
+ * Only meaningful to the scene the body belongs to.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param index the body's index in the scene's own bookkeeping
+ */
+void body_set_scene_index(Body *body, size_t index);
+
+/**
+ * Gets the index set by body_set_scene_index().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's index in the scene's own bookkeeping
+ */
+size_t body_get_scene_index(Body *body);
+
 /**
  * Marks a body for removal--future calls to body_is_removed() will return true.
  * Does not free the body.
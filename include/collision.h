@@ -2,6 +2,7 @@
 #define __COLLISION_H__
 
 #include <stdbool.h>
+#include "body.h"
 #include "list.h"
 #include "vector.h"
 
@@ -19,6 +20,12 @@ typedef struct {
      * If collided is false, this value is undefined.
      */
     Vector axis;
+    /**
+     * If the shapes are colliding, how far they overlap along the axis,
+     * i.e. how far they would have to move apart to stop colliding.
+     * If collided is false, this value is undefined.
+     */
+    double overlap;
 } CollisionInfo;
 
 /**
@@ -34,4 +41,47 @@ typedef struct {
  */
 CollisionInfo find_collision(List *shape1, List *shape2);
 
+/**
+ * Computes the status of the collision between two convex polygons
+ * whose edge normals are already known, using the separating axis theorem.
+ * Every edge normal of both shapes is tried as a separating axis,
+ * so no trigonometry or square roots are needed.
+ *
+ * @param shape1 the vertices of the first shape, in order
+ * @param normals1 the unit outward normals of shape1's edges
+ * @param centroid1 the centroid of the first shape
+ * @param shape2 the vertices of the second shape, in order
+ * @param normals2 the unit outward normals of shape2's edges
+ * @param centroid2 the centroid of the second shape
+ * @return whether the shapes are colliding, and if so, the collision axis,
+ *   pointing from shape1 towards shape2
+ */
+CollisionInfo find_polygon_collision(
+  const VectorArray *shape1, const VectorArray *normals1, Vector centroid1,
+  const VectorArray *shape2, const VectorArray *normals2, Vector centroid2
+);
+
+/**
+ * Computes the status of the collision between two bodies.
+ * Equivalent to find_collision() on the bodies' shapes, but uses the
+ * vertices, edge normals, and bounding boxes cached by each body,
+ * so nothing is recomputed for bodies that have not moved.
+ * Bodies whose bounding boxes do not overlap are rejected immediately.
+ *
+ * @param body1 the first body
+ * @param body2 the second body
+ * @return whether the bodies are colliding, and if so, the collision axis,
+ *   pointing from body1 towards body2
+ */
+CollisionInfo find_body_collision(Body *body1, Body *body2);
+
+/**
+ * Gets the number of separating axis tests run so far,
+ * i.e. calls to find_polygon_collision(), including the ones made by
+ * find_collision() and find_body_collision() for overlapping bounding boxes.
+ *
+ * @return the number of tests since the program started
+ */
+size_t collision_test_count(void);
+
 #endif // #ifndef __COLLISION_H__
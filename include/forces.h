@@ -4,19 +4,39 @@
 #include "scene.h"
 #include "collision.h"
 
-// Structs to hold helper data for gravity, spring, and drag creators
+// Structs to hold helper data for gravity, spring, and collision creators
 typedef struct gravity_params GravityParams;
 
 typedef struct spring_params SpringParams;
 
-typedef struct drag_params DragParams;
-
 typedef struct coll_params CollParams;
 
 typedef struct phys_coll_params PhysCollParams;
 
 typedef struct gen_coll_params GenCollParams;
 
+typedef struct uniform_gravity_params UniformGravityParams;
+
+typedef struct half_plane_params HalfPlaneParams;
+
+/**
+ * A set of bodies that all attract each other by Newtonian gravity.
+ * See create_gravity_group().
+ */
+typedef struct gravity_group GravityGroup;
+
+/**
+ * A uniform gravitational field, like the one near the surface of a planet.
+ * Every body in the field is accelerated equally, regardless of its mass.
+ * The field belongs to the caller, who can change its acceleration at any
+ * time (e.g. to flip gravity) without touching the scene;
+ * the change takes effect on the next tick, waking any sleeping bodies in the field.
+ */
+typedef struct {
+  /** The acceleration of every body in the field */
+  Vector acceleration;
+} GravityField;
+
 
 /**
  * Adds a Newtonian gravitational force between two bodies in a scene.
@@ -33,6 +53,79 @@ void create_newtonian_gravity(Scene *scene, double G, Body *body1, Body *body2);
 
 void GravityForceCreator(void *aux);
 
+void GravityBatchForceCreator(void *params, size_t count);
+
+/**
+ * Adds a group of bodies to a scene that all attract each other by
+ * Newtonian gravity, like create_newtonian_gravity() between every pair,
+ * but with a single force creator and no per-pair allocations.
+ * Bodies are added with gravity_group_add(), and leave the group when removed.
+ *
+ * Small groups (see gravity_group_set_direct_max()) compute every pair exactly,
+ * once per pair, in a loop over the bodies' positions and masses that the
+ * compiler can vectorize. Larger groups approximate the forces with a
+ * Barnes-Hut quadtree, in O(N log N) time: a cell of the tree whose width is
+ * less than theta times its distance from a body acts on it as a single mass
+ * at the cell's center of mass. Smaller values of theta are more accurate;
+ * 0 computes every pair exactly.
+ * As with create_newtonian_gravity(), there is no force between bodies
+ * (or a body and a cell) closer together than the scene's gravity limit.
+ * Every body in the group must have finite mass.
+ *
+ * @param scene the scene containing the bodies
+ * @param G the gravitational proportionality constant
+ * @param theta the opening angle of the approximation, or 0 for exact forces
+ * @return the group, which is owned and eventually freed by the scene
+ */
+GravityGroup *create_gravity_group(Scene *scene, double G, double theta);
+
+/**
+ * Adds a body to a gravity group.
+ *
+ * @param group a gravity group returned from create_gravity_group()
+ * @param body a body in the same scene as the group
+ */
+void gravity_group_add(GravityGroup *group, Body *body);
+
+/**
+ * Sets the largest gravity group that is computed exactly, pair by pair,
+ * instead of with the quadtree. The default is 1024, about where the two
+ * take the same time with theta = 0.5; below that, the exact computation is faster.
+ *
+ * @param group a gravity group returned from create_gravity_group()
+ * @param max_bodies the most bodies to compute pair by pair;
+ *   0 always uses the quadtree
+ */
+void gravity_group_set_direct_max(GravityGroup *group, size_t max_bodies);
+
+/**
+ * Gets the number of bodies in a gravity group.
+ *
+ * @param group a gravity group returned from create_gravity_group()
+ * @return the number of bodies in the group that have not been removed
+ */
+size_t gravity_group_size(GravityGroup *group);
+
+void GravityGroupForceCreator(void *aux);
+
+/**
+ * Adds the force of a uniform gravitational field on a body in a scene.
+ * The same field can be shared by the force creators of many bodies.
+ * Bodies with infinite mass are not affected.
+ *
+ * @param scene the scene containing the body
+ * @param field the field to apply. It is not copied, so it must stay valid
+ *   until the body is removed or the scene is freed.
+ * @param body the body the field acts on
+ */
+void create_uniform_gravity(Scene *scene, const GravityField *field, Body *body);
+
+void UniformGravityForceCreator(void *aux);
+
+bool UniformGravityChanged(void *aux);
+
+void UniformGravityBatchForceCreator(void *params, size_t count);
+
 /**
  * Adds a Hooke's-Law spring force between two bodies in a scene.
  * See https://en.wikipedia.org/wiki/Hooke%27s_law.
@@ -46,19 +139,22 @@ void create_spring(Scene *scene, double k, Body *body1, Body *body2);
 
 void SpringForceCreator(void *aux);
 
+void SpringBatchForceCreator(void *params, size_t count);
+
 /**
  * Adds a drag force on a body proportional to its velocity.
  * The force points opposite the body's velocity.
+ * The drag is added to the body's linear damping (see body_set_damping()),
+ * so the scene applies it while integrating the body, without a force creator.
  *
- * @param scene the scene containing the bodies
+ * @param scene the scene containing the body. It is not used, since the drag
+ *   is stored on the body, but is kept so that callers match the other forces.
  * @param gamma the proportionality constant between force and velocity
  *   (higher gamma means more drag)
  * @param body the body to slow down
  */
 void create_drag(Scene *scene, double gamma, Body *body);
 
-void DragForceCreator(void *aux);
-
 /**
  * Adds a ForceCreator to a scene that calls a given CollisionHandler
  * each time two bodies collide.
@@ -85,6 +181,8 @@ void create_collision(
 
 void CollisionCreator(void* aux);
 
+void CollisionBatchCreator(void *params, size_t count);
+
 /**
  * Adds a ForceCreator to a scene that destroys two bodies when they collide.
  * The bodies should be destroyed by calling body_remove().
@@ -97,16 +195,21 @@ void create_destructive_collision(Scene *scene, Body *body1, Body *body2);
 
 void DestructiveCollisionCreator(void *aux);
 
+void DestructiveCollisionBatchCreator(void *params, size_t count);
+
 /**
- * Adds a ForceCreator to a scene that applies impulses
- * to resolve collisions between two bodies in the scene.
- * This should be represented as an on-collision callback
- * registered with create_collision().
+ * Adds a contact constraint to a scene that keeps two bodies from
+ * overlapping, by applying impulses when they collide.
  *
- * You may remember from project01 that you should avoid applying impulses
- * multiple times while the bodies are still colliding.
- * You should also have a special case that allows either body1 or body2
- * to have mass INFINITY, as this is useful for simulating walls.
+ * The contacts of a scene are solved together by sequential impulses
+ * (see scene_set_solver_iterations()), so stacks of touching bodies and
+ * bodies resting on each other settle instead of jittering.
+ * Overlapping bodies are also pushed most of the way apart each tick.
+ * The total impulse applied to each contact is remembered and re-applied
+ * on the next tick (warm starting), so resting contacts converge quickly.
+ *
+ * Either body may have mass INFINITY (or be kinematic or static),
+ * which is useful for simulating walls.
  *
  * @param scene the scene containing the bodies
  * @param elasticity the "coefficient of restitution" of the collision;
@@ -118,7 +221,34 @@ void create_physics_collision(
     Scene *scene, double elasticity, Body *body1, Body *body2
 );
 
-void PhysicsCollisionCreator(void *aux);
+void PhysicsCollisionPrepare(void *aux);
+
+void PhysicsCollisionSolve(void *aux);
+
+/**
+ * Adds a constraint to a scene that keeps a body on one side of a line,
+ * like a floor or a wall that only the body can touch.
+ * Every tick, after the body has moved, any part of the body
+ * past the line is pushed back onto it, and any velocity into the line
+ * is removed (or reflected, if the contact is elastic).
+ * Velocity away from the line is left alone, so the body can leave freely.
+ *
+ * Unlike a collision with an infinite-mass body, the constraint needs no
+ * body for the wall and no collision detection beyond the body's vertices.
+ *
+ * @param scene the scene containing the body
+ * @param point any point on the line
+ * @param normal a vector perpendicular to the line, pointing towards the
+ *   side the body must stay on. It does not need to be a unit vector.
+ * @param elasticity the coefficient of restitution of the contact;
+ *   0 stops the body against the line and 1 bounces it off perfectly
+ * @param body the body to constrain
+ */
+void create_half_plane(
+    Scene *scene, Vector point, Vector normal, double elasticity, Body *body
+);
+
+void HalfPlaneConstraint(void *aux);
 
 Vector unit_vector(Vector v);
 
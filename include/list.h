@@ -1,6 +1,7 @@
 #ifndef __LIST_H__
 #define __LIST_H__
 
+#include <stdbool.h>
 #include <stddef.h>
 
 /**
@@ -16,6 +17,12 @@ typedef struct list List;
  */
 typedef void (*FreeFunc)(void *data);
 
+/**
+ * A function that decides whether a list element should be removed.
+ * Examples: body_is_removed
+ */
+typedef bool (*ListPredicate)(void *data);
+
 /**
  * Allocates memory for a new list with space for the given number of elements.
  * The list is initially empty.
@@ -77,6 +84,22 @@ void *list_remove(List *list, size_t index);
  */
 void list_add(List *list, void *value);
 
+/**
+ * Removes every element of a list that satisfies a predicate,
+ * in a single pass over the list.
+ * Removed elements are passed to the list's freer, if it has one.
+ *
+ * If stable is true, the remaining elements keep their relative order.
+ * Otherwise each removed element is replaced by the last element of the list,
+ * which is cheaper but does not preserve order.
+ *
+ * @param list a pointer to a list returned from list_init()
+ * @param should_remove returns true for the elements to remove
+ * @param stable whether to preserve the order of the remaining elements
+ * @return the number of elements removed
+ */
+size_t list_remove_if(List *list, ListPredicate should_remove, bool stable);
+
 void print_list(List *list);
 
 #endif // #ifndef __LIST_H__
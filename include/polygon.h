@@ -4,6 +4,20 @@
 #include "list.h"
 #include "vector.h"
 
+/**
+ * Everything about a polygon that can be computed in one pass over its edges.
+ */
+typedef struct {
+  /** The signed area: positive if counterclockwise, negative if clockwise */
+  double area;
+  /** The center of mass */
+  Vector centroid;
+  /** The bottom left corner of the axis-aligned bounding box */
+  Vector min;
+  /** The top right corner of the axis-aligned bounding box */
+  Vector max;
+} PolygonMetrics;
+
 /**
  * Computes the area of a polygon.
  * See https://en.wikipedia.org/wiki/Shoelace_formula#Statement.
@@ -26,6 +40,31 @@ double polygon_area(List *polygon);
  */
 Vector polygon_centroid(List *polygon);
 
+/**
+ * Computes a polygon's signed area, centroid, and bounding box together,
+ * visiting each edge once. Much cheaper than calling polygon_area()
+ * and polygon_centroid() separately.
+ *
+ * @param vertices the vertices of the polygon, in order
+ * @param count the number of vertices
+ * @return the polygon's metrics. If the polygon has no area,
+ *   the centroid is the average of its vertices.
+ */
+PolygonMetrics polygon_metrics(const Vector *vertices, size_t count);
+
+/**
+ * Computes the unit normal of each edge of a polygon.
+ * Normal i is perpendicular to the edge from vertex i to the next vertex.
+ * Zero-length edges get a zero normal.
+ *
+ * @param vertices the vertices of the polygon, in order
+ * @param count the number of vertices
+ * @param orientation 1 if the vertices are counterclockwise, -1 if clockwise,
+ *   so that the normals point out of the polygon
+ * @param normals set to the count edge normals
+ */
+void polygon_edge_normals(const Vector *vertices, size_t count, double orientation, Vector *normals);
+
 /**
  * Translates all vertices in a polygon by a given vector.
  * Note: mutates the original polygon.
@@ -46,4 +85,23 @@ void polygon_translate(List *polygon, Vector translation);
  */
 void polygon_rotate(List *polygon, double angle, Vector point);
 
+/**
+ * Translates all vertices in a polygon stored by value.
+ * Same as polygon_translate(), but for a VectorArray.
+ *
+ * @param polygon the array of vertices that make up the polygon
+ * @param translation the vector to add to each vertex's position
+ */
+void polygon_translate_array(VectorArray *polygon, Vector translation);
+
+/**
+ * Rotates vertices in a polygon stored by value about a given point.
+ * Same as polygon_rotate(), but for a VectorArray.
+ *
+ * @param polygon the array of vertices that make up the polygon
+ * @param angle the angle to rotate the polygon, in radians
+ * @param point the point to rotate around
+ */
+void polygon_rotate_array(VectorArray *polygon, double angle, Vector point);
+
 #endif // #ifndef __POLYGON_H__
@@ -5,6 +5,82 @@
 #include "body.h"
 #include "list.h"
 
+/**
+ * The numerical methods a scene can use to move its dynamic bodies.
+ */
+typedef enum {
+  /**
+   * body_tick(): moves at the average of the velocities before and after
+   * the step. The default.
+   */
+  INTEGRATOR_TRAPEZOID,
+  /** body_tick_symplectic_euler(): cheapest, and energy stays bounded */
+  INTEGRATOR_SYMPLECTIC_EULER,
+  /** body_tick_verlet(): second-order accurate, and energy stays bounded */
+  INTEGRATOR_VELOCITY_VERLET,
+  /**
+   * Fourth-order Runge-Kutta: the most accurate per step, but runs
+   * the force creators four times per tick, with the bodies moved to
+   * intermediate positions. The force creators should therefore only
+   * depend on the bodies' positions and velocities.
+   * Kinematic bodies stay where they are until the end of the step.
+   */
+  INTEGRATOR_RK4
+} Integrator;
+
+/**
+ * The stages of a tick timed by a scene's statistics (see scene_get_stats()).
+ */
+typedef enum {
+  /** Running the force creators, including batched ones */
+  SCENE_STAGE_FORCES,
+  /** Moving the bodies; with INTEGRATOR_RK4 this includes its force evaluations */
+  SCENE_STAGE_INTEGRATE,
+  /** Solving the constraints */
+  SCENE_STAGE_CONSTRAINTS,
+  /** Removing the force creators that act on removed bodies */
+  SCENE_STAGE_REAP_FORCERS,
+  /** Finding and freeing removed bodies */
+  SCENE_STAGE_REAP_BODIES,
+  /** Putting resting bodies to sleep */
+  SCENE_STAGE_SLEEP,
+  /** The whole of scene_tick() */
+  SCENE_STAGE_TICK,
+  /** scene_render(), which is timed per call rather than per tick */
+  SCENE_STAGE_RENDER,
+  SCENE_STAGE_COUNT
+} SceneStage;
+
+/**
+ * A summary of one quantity over a scene's recent ticks.
+ */
+typedef struct {
+  /** The value for the most recent tick */
+  double last;
+  double average;
+  double median;
+  /** The 95th and 99th percentiles (nearest rank) */
+  double p95;
+  double p99;
+  double max;
+} SceneSampleStats;
+
+/**
+ * Timings and counts from a scene's recent ticks.
+ * Times are in seconds.
+ */
+typedef struct {
+  /** The number of ticks summarized, at most the window size */
+  size_t ticks;
+  SceneSampleStats stages[SCENE_STAGE_COUNT];
+  /** Force creators and constraint solves run per tick, counting each batched one */
+  SceneSampleStats forcers_run;
+  /** Separating axis tests per tick (see collision_test_count()) */
+  SceneSampleStats sat_tests;
+  /** Bodies removed per tick */
+  SceneSampleStats bodies_removed;
+} SceneStats;
+
 /**
  * A collection of bodies and force creators.
  * The scene automatically resizes to store
@@ -14,6 +90,18 @@ typedef struct scene Scene;
 
 typedef struct forcer Forcer;
 
+/**
+ * The number of bodies a force creator can depend on
+ * before the scene has to allocate memory to store them.
+ */
+#define FORCER_INLINE_BODIES 2
+
+/**
+ * The size of the auxiliary value that the scene can store inside a force
+ * creator; see scene_add_inline_force_creator().
+ */
+#define FORCER_INLINE_AUX_SIZE 64
+
 /**
  * A function which adds some forces or impulses to bodies,
  * e.g. from collisions, gravity, or spring forces.
@@ -23,6 +111,22 @@ typedef void (*ForceCreator)(void *aux);
 
 typedef void (*CollisionHandler)(Body *body1, Body *body2, Vector axis, void *aux);
 
+/**
+ * A function which draws a filled polygon, e.g. onto a window.
+ * Takes in the auxiliary value of the SceneView it belongs to.
+ */
+typedef void (*PolygonDrawer)(void *aux, const Vector *vertices, size_t count, RGBColor color);
+
+/**
+ * Where scene_render() draws a scene's bodies.
+ * The scene itself knows nothing about windows or graphics libraries,
+ * so it can be simulated without any display.
+ */
+typedef struct {
+  PolygonDrawer draw_polygon;
+  void *aux;
+} SceneView;
+
 /**
  * Allocates memory for an empty scene.
  * Makes a reasonable guess of the number of bodies to allocate space for.
@@ -60,6 +164,8 @@ Body *scene_get_body(Scene *scene, size_t index);
 
 /**
  * Adds a body to a scene.
+ * The body's type (see body_set_type()) decides which of the scene's
+ * partitions it is kept in, so it must not change afterwards.
  *
  * @param scene a pointer to a scene returned from scene_init()
  * @param body a pointer to the body to add to the scene
@@ -98,18 +204,212 @@ void scene_add_force_creator(
  * @param bodies the list of bodies affected by the force creator.
  *   The force creator will be removed if any of these bodies are removed.
  *   This list does not own the bodies, so its freer should be NULL.
+ *   The scene copies the bodies out of the list and then frees it.
  * @param freer if non-NULL, a function to call in order to free aux
  */
 void scene_add_bodies_force_creator(
     Scene *scene, ForceCreator forcer, void *aux, List *bodies, FreeFunc freer
 );
 
+/**
+ * Adds a force creator to a scene, like scene_add_bodies_force_creator(),
+ * but takes the affected bodies as an array instead of a List.
+ * The bodies are copied into the force creator; up to FORCER_INLINE_BODIES
+ * of them are stored without allocating any memory.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param forcer a force creator function
+ * @param aux an auxiliary value to pass to forcer when it is called
+ * @param bodies the bodies affected by the force creator
+ * @param count the number of bodies in the array
+ * @param freer if non-NULL, a function to call in order to free aux
+ */
+void scene_add_force_creator_with_bodies(
+    Scene *scene, ForceCreator forcer, void *aux,
+    Body *const *bodies, size_t count, FreeFunc freer
+);
+
+/**
+ * Adds a force creator that keeps track of its own, changing set of bodies,
+ * such as a gravity group acting on every body added to it.
+ * Unlike other force creators, it is not removed along with any of its bodies.
+ * Instead, whenever removed bodies are about to be freed, prune is called
+ * with aux so it can forget them; body_is_removed() is still valid then.
+ *
+ * If the group's bodies are given, they are treated as one island when
+ * sleeping is enabled (see scene_set_sleeping()): they go to sleep and wake up
+ * together, and the force creator is skipped while all of them are asleep.
+ * Otherwise the force creator always runs, and may keep waking its bodies.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param forcer a force creator function
+ * @param prune a function to call with aux before removed bodies are freed
+ * @param aux an auxiliary value to pass to forcer and prune.
+ *   It is not moved by the scene, so the caller may keep pointers to it.
+ * @param bodies the bodies the group acts on, read by the scene every tick
+ *   (usually an array inside aux), or NULL. Entries may be NULL.
+ * @param freer if non-NULL, a function to call in order to free aux
+ */
+void scene_add_group_force_creator(
+    Scene *scene, ForceCreator forcer, ForceCreator prune, void *aux,
+    const BodyArray *bodies, FreeFunc freer
+);
+
+/**
+ * Adds a force creator whose auxiliary value is stored by the scene itself.
+ * If aux_size is at most FORCER_INLINE_AUX_SIZE, the value lives inside the
+ * force creator and adding it does not allocate any memory.
+ * The caller must initialize the returned value before the next scene_tick().
+ *
+ * Because the value may move when other force creators are added or removed,
+ * the returned pointer (and the aux passed to the force creator)
+ * is only valid until the scene's force creators next change.
+ * In particular, a force creator should not use its aux after calling
+ * anything that may add force creators.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param forcer a force creator function
+ * @param aux_size the size of the auxiliary value, in bytes
+ * @param bodies the bodies affected by the force creator
+ * @param count the number of bodies in the array
+ * @param cleanup if non-NULL, a function to call on the auxiliary value
+ *   when the force creator is removed, to release anything it refers to.
+ *   It must not free the value itself.
+ * @return the auxiliary value, to be initialized by the caller
+ */
+void *scene_add_inline_force_creator(
+    Scene *scene, ForceCreator forcer, size_t aux_size,
+    Body *const *bodies, size_t count, FreeFunc cleanup
+);
+
+/**
+ * A function that applies the forces of many force creators of the same kind.
+ * Calling it on an array of parameters must be equivalent to calling it
+ * on each element of the array in turn.
+ *
+ * @param params an array of the force creators' parameters
+ * @param count the number of elements in the array
+ */
+typedef void (*BatchForceCreator)(void *params, size_t count);
+
+/**
+ * Adds a force creator to a scene's batch of force creators of the same kind.
+ * The scene keeps one batch per BatchForceCreator, with the parameters of
+ * all its force creators stored contiguously, and runs the whole batch
+ * with one call instead of one indirect call per force creator.
+ * When some of the force creators are asleep, the batch is called once
+ * for each run of force creators that are awake.
+ * Batches are run before the scene's other force creators.
+ *
+ * Otherwise, a batched force creator behaves like one added with
+ * scene_add_inline_force_creator(): it is removed along with any of its bodies,
+ * and the returned parameters are only valid until its batch next changes.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param batch the function that applies the batch's forces
+ * @param params_size the size of each force creator's parameters, in bytes;
+ *   the same for every force creator in the batch
+ * @param bodies the bodies affected by the force creator
+ * @param count the number of bodies in the array, at most FORCER_INLINE_BODIES
+ * @param cleanup if non-NULL, a function to call on the parameters when the
+ *   force creator is removed, to release anything they refer to.
+ *   It must not free the parameters themselves.
+ *   Only the first cleanup passed for a batch is used.
+ * @return the force creator's parameters, to be initialized by the caller
+ */
+void *scene_add_batched_force_creator(
+    Scene *scene, BatchForceCreator batch, size_t params_size,
+    Body *const *bodies, size_t count, FreeFunc cleanup
+);
+
+/**
+ * A function that decides whether a batched force creator whose bodies are
+ * all asleep should run anyway, e.g. because the force it applies has changed
+ * since it last ran. A force creator that applies a nonzero force wakes its bodies.
+ *
+ * @param params the force creator's parameters
+ * @return true to run the force creator
+ */
+typedef bool (*BatchWakeCheck)(void *params);
+
+/**
+ * Sets the function that decides whether a batch's sleeping force creators
+ * should run (see BatchWakeCheck). It is only called when sleeping is enabled,
+ * once per tick for each force creator whose bodies are all asleep.
+ * The batch must already have a force creator in it.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param batch the function that applies the batch's forces
+ * @param check the wake check, or NULL to always skip sleeping force creators
+ */
+void scene_set_batch_wake_check(Scene *scene, BatchForceCreator batch, BatchWakeCheck check);
+
+/**
+ * Adds a constraint to a scene.
+ * A constraint is called just like a force creator, but *after* the bodies
+ * have been ticked, so it can directly correct their positions and
+ * velocities (e.g. to keep them out of a wall) instead of applying forces.
+ * It is called once per solver iteration (see scene_set_solver_iterations()),
+ * so applying it twice in a row should be harmless.
+ * Like force creators, constraints are removed along with any of their bodies,
+ * and their auxiliary value is stored by the scene
+ * (see scene_add_inline_force_creator()).
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param constraint a function that corrects the bodies it constrains
+ * @param aux_size the size of the constraint's auxiliary value, in bytes
+ * @param bodies the bodies the constraint acts on
+ * @param count the number of bodies in the array
+ * @param cleanup if non-NULL, a function to call on the value before it is freed
+ * @return a pointer to the new, uninitialized auxiliary value
+ */
+void *scene_add_constraint(
+    Scene *scene, ForceCreator constraint, size_t aux_size,
+    Body *const *bodies, size_t count, FreeFunc cleanup
+);
+
+/**
+ * Adds a constraint that is solved iteratively along with the others.
+ * Each tick, prepare is called once on every such constraint
+ * (e.g. to find contacts, and to re-apply last tick's impulses),
+ * and then solve is called on every constraint, in turn, once per iteration.
+ * See scene_set_solver_iterations().
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param prepare if non-NULL, a function called once per tick on the aux value
+ * @param solve a function called once per iteration on the aux value
+ * @param aux_size the size of the constraint's auxiliary value, in bytes
+ * @param bodies the bodies the constraint acts on
+ * @param count the number of bodies in the array
+ * @param cleanup if non-NULL, a function to call on the value before it is freed
+ * @return a pointer to the new, uninitialized auxiliary value
+ */
+void *scene_add_iterative_constraint(
+    Scene *scene, ForceCreator prepare, ForceCreator solve, size_t aux_size,
+    Body *const *bodies, size_t count, FreeFunc cleanup
+);
+
+/**
+ * Sets how many times the scene's constraints are applied each tick.
+ * More iterations let contacts between many touching bodies (e.g. stacks)
+ * settle more accurately, at the cost of more time per tick.
+ * The default is 8.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param iterations the number of iterations, which must be positive
+ */
+void scene_set_solver_iterations(Scene *scene, size_t iterations);
+
 /**
  * Executes a tick of a given scene over a small time interval.
  * This requires executing all the force creators
  * and then ticking each body (see body_tick()).
+ * Kinematic bodies are ticked separately with body_tick_kinematic(),
+ * and static bodies are not ticked at all.
+ * Finally, the constraints are applied (see scene_add_constraint()).
  * If any bodies are marked for removal, they should be removed from the scene
  * and freed, along with any force creators acting on them.
+ * Nothing is drawn; see scene_render().
  *
  * @param scene a pointer to a scene returned from scene_init()
  * @param dt the time elapsed since the last tick, in seconds
@@ -117,6 +417,144 @@ void scene_add_bodies_force_creator(
  */
 void scene_tick(Scene *scene, double dt);
 
+/**
+ * Gets the time step of the tick in progress, for force creators
+ * that depend on it (e.g. ones that solve for the forces implicitly).
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @return the dt passed to the current (or last) call to scene_tick(),
+ *   or 0 if the scene has never been ticked
+ */
+double scene_get_tick_dt(Scene *scene);
+
+/**
+ * Draws every body in a scene, in the order they were added.
+ * Bodies without at least three vertices are skipped.
+ * This is separate from scene_tick(), so a scene can be ticked any number
+ * of times with a fixed dt for each frame that is drawn.
+ * The bodies can be drawn part of the way between where they were before
+ * the last tick and where they are now, using the time left over
+ * after the last tick as a fraction of its dt.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param view where to draw the bodies
+ * @param alpha how far through the last tick to draw the bodies,
+ *   from 0 (before it) to 1 (after it)
+ */
+void scene_render(Scene *scene, SceneView *view, double alpha);
+
+/**
+ * Removes and frees every body marked for removal, along with any force
+ * creators acting on them, without ticking the scene.
+ * This happens in a single pass over the scene's bodies.
+ * If called from inside a force creator, the removal is deferred
+ * until all the force creators for the current tick have run.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ */
 void scene_tick_delete_only(Scene *scene);
 
+/**
+ * Chooses how the scene fills the gaps left by removed bodies.
+ * By default removal is stable: the remaining bodies keep their relative
+ * order, and so their indices and draw order.
+ * Scenes that do not care about draw order can turn this off,
+ * in which case each removed body is replaced by the last body in the scene.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param stable whether removal should preserve the order of the bodies
+ */
+void scene_set_stable_removal(Scene *scene, bool stable);
+
+/**
+ * Chooses how the scene moves its dynamic bodies in scene_tick().
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param integrator the integration method to use from the next tick on
+ */
+void scene_set_integrator(Scene *scene, Integrator integrator);
+
+/**
+ * Chooses how the bodies' damping (see body_set_damping()) is applied.
+ * By default, the damping force is integrated along with the other forces,
+ * which overshoots (reversing the velocity) if damping times dt exceeds the mass.
+ * With exact damping, each body's velocity instead decays exactly as the
+ * damping alone would make it over the step (see body_apply_damping()),
+ * which is stable for any damping and dt.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param exact true to apply the damping as exact decay
+ */
+void scene_set_exact_damping(Scene *scene, bool exact);
+
+/**
+ * Lets resting dynamic bodies fall asleep, so scene_tick() stops
+ * integrating them and stops running force creators that only act on
+ * sleeping or static bodies (including collision checks between them).
+ *
+ * Dynamic bodies that share a force creator form an island, and an island
+ * falls asleep once every body in it has been slower than the given speed
+ * for the given time. Applying a force or impulse to a sleeping body,
+ * or moving it, wakes it up, and the rest of its island wakes up with it.
+ * A body that collides with a moving body is woken up by the impulse.
+ *
+ * Sleeping is off by default.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param speed the speed bodies must stay below to count as resting,
+ *   or 0 to disable sleeping (which wakes every body up)
+ * @param time how long an island must rest before it falls asleep, in seconds
+ */
+void scene_set_sleeping(Scene *scene, double speed, double time);
+
+/**
+ * Returns whether scene_set_sleeping() has enabled sleeping.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @return true if resting bodies can fall asleep
+ */
+bool scene_sleeping_enabled(Scene *scene);
+
+/**
+ * Lets fast bodies take several smaller steps within one scene_tick(),
+ * while the rest of the scene takes a single step.
+ * A dynamic body is substepped when its velocity and acceleration would move it
+ * further than max_motion times the smaller side of its bounding box in one tick.
+ * Before each substep after the first, the force creators added with
+ * the body are run again, and only the forces they apply to that body are kept.
+ * Force creators added without their bodies only run once per tick.
+ * Has no effect with INTEGRATOR_RK4, which already re-evaluates the forces.
+ * Adaptive substepping is disabled by default.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param max_motion the largest fraction of its size a body may move in one step,
+ *   or 0 to disable adaptive substepping
+ * @param max_substeps the most substeps any body takes in one tick; must be positive
+ */
+void scene_set_adaptive_substeps(Scene *scene, double max_motion, size_t max_substeps);
+
+/**
+ * Starts (or stops) timing each stage of scene_tick() and scene_render(),
+ * and counting the work done in each tick, over a rolling window of ticks.
+ * Only work done inside scene_tick() is counted: calling
+ * scene_tick_delete_only() or find_collision() between ticks
+ * does not add to the next tick's statistics.
+ * Any statistics already collected are discarded.
+ * Statistics are disabled by default, and cost a few clock reads per tick.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param ticks how many of the most recent ticks to summarize, or 0 to disable
+ */
+void scene_set_stats_window(Scene *scene, size_t ticks);
+
+/**
+ * Summarizes the timings and counts of a scene's recent ticks
+ * (see scene_set_stats_window()). If statistics are disabled,
+ * or no ticks have been recorded, everything is 0.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @return the statistics of the recorded ticks
+ */
+SceneStats scene_get_stats(Scene *scene);
+
 #endif // #ifndef __SCENE_H__
@@ -69,6 +69,16 @@ void sdl_clear(void);
  */
 void sdl_draw_polygon(List *points, RGBColor color);
 
+/**
+ * Draws a polygon from an array of vertices and a color.
+ * Same as sdl_draw_polygon(), but without needing a List.
+ *
+ * @param vertices the vertices of the polygon
+ * @param count the number of vertices
+ * @param color the color used to fill in the polygon
+ */
+void sdl_draw_vertices(const Vector *vertices, size_t count, RGBColor color);
+
 /**
  * Draws a pie from the given position, radius, slice angles, and color.
  *
@@ -95,9 +105,18 @@ void sdl_draw_circle(Vector pos, int rad, RGBColor color);
  */
 void sdl_show(void);
 
+/**
+ * Gets a view that draws a scene's bodies onto the frame being built
+ * with sdl_draw_vertices(), for scene_render().
+ * The frame is not cleared or shown, so other things can be drawn around them.
+ *
+ * @return the SDL window's scene view
+ */
+SceneView sdl_scene_view(void);
+
 /**
  * Draws all bodies in a scene.
- * This internally calls sdl_clear(), sdl_draw_polygon(), and sdl_show(),
+ * This internally calls sdl_clear(), scene_render(), and sdl_show(),
  * so those functions should not be called directly.
  *
  * @param scene the scene to draw
@@ -0,0 +1,88 @@
+#ifndef __SHAPE_H__
+#define __SHAPE_H__
+
+#include <stddef.h>
+#include "list.h"
+#include "vector.h"
+
+/**
+ * An immutable convex polygon that can be shared by many bodies.
+ * The vertices are stored relative to the polygon's centroid,
+ * and data that only depends on the polygon (its area, edge normals,
+ * and bounding box) is computed once when the shape is created.
+ *
+ * Shapes are reference-counted: each body using a shape holds a reference,
+ * and the shape is freed when the last reference is released.
+ */
+typedef struct shape Shape;
+
+/**
+ * Creates a shape from a list of vertices.
+ * The new shape starts with a single reference, owned by the caller.
+ *
+ * @param points the vertices of the polygon, in order.
+ *   The vertices are copied into the shape, and the list is freed.
+ * @return a pointer to the newly allocated shape
+ */
+Shape *shape_init(List *points);
+
+/**
+ * Adds a reference to a shape.
+ *
+ * @param shape a pointer to a shape returned from shape_init()
+ * @return the same shape, for convenience
+ */
+Shape *shape_retain(Shape *shape);
+
+/**
+ * Releases a reference to a shape, freeing it if it was the last one.
+ *
+ * @param shape a pointer to a shape returned from shape_init()
+ */
+void shape_release(Shape *shape);
+
+/**
+ * Gets the vertices of a shape, relative to its centroid.
+ *
+ * @param shape a pointer to a shape returned from shape_init()
+ * @return the shape's vertices, which must not be modified
+ */
+const VectorArray *shape_get_vertices(Shape *shape);
+
+/**
+ * Gets the unit normals of a shape's edges.
+ * Normal i is perpendicular to the edge from vertex i to vertex i + 1
+ * (or vertex 0, for the last edge) and points out of the polygon.
+ *
+ * @param shape a pointer to a shape returned from shape_init()
+ * @return the shape's edge normals, which must not be modified
+ */
+const VectorArray *shape_get_normals(Shape *shape);
+
+/**
+ * Gets the area of a shape.
+ *
+ * @param shape a pointer to a shape returned from shape_init()
+ * @return the (non-negative) area enclosed by the shape
+ */
+double shape_get_area(Shape *shape);
+
+/**
+ * Gets the centroid of the vertices the shape was created from.
+ * Bodies created from the shape start out centered at this point.
+ *
+ * @param shape a pointer to a shape returned from shape_init()
+ * @return the shape's original centroid
+ */
+Vector shape_get_centroid(Shape *shape);
+
+/**
+ * Gets the axis-aligned bounding box of a shape, relative to its centroid.
+ *
+ * @param shape a pointer to a shape returned from shape_init()
+ * @param min set to the bottom left corner of the box
+ * @param max set to the top right corner of the box
+ */
+void shape_get_bounds(Shape *shape, Vector *min, Vector *max);
+
+#endif // #ifndef __SHAPE_H__
@@ -0,0 +1,82 @@
+#ifndef __SPRING_NETWORK_H__
+#define __SPRING_NETWORK_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "body.h"
+#include "scene.h"
+
+/**
+ * Many springs between a set of bodies, like a rope or a piece of cloth,
+ * applied to a scene by a single force creator.
+ *
+ * The springs are stored in compressed sparse row form, so they are all
+ * evaluated in one pass over contiguous arrays, with no allocation per spring.
+ * Optionally, the springs' forces can be solved for implicitly
+ * (see spring_network_set_implicit()), so that stiff springs stay stable
+ * without shrinking the scene's time step.
+ */
+typedef struct spring_network SpringNetwork;
+
+/**
+ * Adds an empty spring network to a scene.
+ *
+ * @param scene the scene containing the network's bodies
+ * @return the network, which is owned and eventually freed by the scene
+ */
+SpringNetwork *create_spring_network(Scene *scene);
+
+/**
+ * Adds a body to a spring network, so springs can be attached to it.
+ * Bodies with infinite mass, and kinematic and static bodies,
+ * act as fixed anchors for the springs attached to them.
+ * When the body is removed from the scene, its springs are removed with it.
+ *
+ * @param network a network returned from create_spring_network()
+ * @param body a body in the same scene as the network
+ * @return the body's index in the network, to pass to spring_network_add_spring()
+ */
+size_t spring_network_add_body(SpringNetwork *network, Body *body);
+
+/**
+ * Adds a Hooke's-Law spring between two bodies in a spring network.
+ * With a rest length of 0, this is the same force as create_spring().
+ *
+ * @param network a network returned from create_spring_network()
+ * @param node1 the index of the first body, from spring_network_add_body()
+ * @param node2 the index of the second body; must differ from node1
+ * @param k the Hooke's constant for the spring
+ * @param rest_length the distance between the bodies at which the spring
+ *   exerts no force
+ */
+void spring_network_add_spring(
+    SpringNetwork *network, size_t node1, size_t node2, double k, double rest_length
+);
+
+/**
+ * Gets the number of springs in a spring network.
+ *
+ * @param network a network returned from create_spring_network()
+ * @return the number of springs whose bodies have not been removed
+ */
+size_t spring_network_springs(SpringNetwork *network);
+
+/**
+ * Chooses whether a spring network applies its springs' current forces,
+ * or solves for the forces implicitly (backward Euler).
+ * An implicit network applies the forces that bring its bodies to the
+ * velocities they will have at the end of the tick, found with the
+ * conjugate gradient method, which stays stable for any stiffness.
+ * Springs with a rest length are linearized as if they had none,
+ * which damps their motion across the spring slightly.
+ * Other forces on the bodies are still applied explicitly.
+ * Meant for the per-body integrators, not INTEGRATOR_RK4.
+ *
+ * @param network a network returned from create_spring_network()
+ * @param implicit true to solve for the forces implicitly
+ */
+void spring_network_set_implicit(SpringNetwork *network, bool implicit);
+
+void SpringNetworkForceCreator(void *aux);
+
+#endif // #ifndef __SPRING_NETWORK_H__
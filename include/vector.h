@@ -1,6 +1,8 @@
 #ifndef __VECTOR_H__
 #define __VECTOR_H__
 
+#include "array.h"
+
 /**
  * A real-valued 2-dimensional vector.
  * Positive x is towards the right; positive y is towards the top.
@@ -11,6 +13,12 @@ typedef struct {
     double y;
 } Vector;
 
+/**
+ * A growable array of vectors stored by value.
+ * See DEFINE_ARRAY() in array.h for the functions it provides.
+ */
+DEFINE_ARRAY(VectorArray, vector_array, Vector)
+
 /**
  * The zero vector, i.e. (0, 0).
  * "extern" declares this global variable without allocating memory for it.
@@ -0,0 +1,215 @@
+#include "alloc_tracker.h"
+#include <assert.h>
+#include <stdint.h>
+
+#define INITIAL_LIVE_CAPACITY 1024
+
+// A tracked block, in an open-addressed hash table keyed by address.
+// The table itself is allocated untracked.
+typedef struct {
+  void *ptr;
+  size_t size;
+  AllocTag tag;
+} LiveBlock;
+
+LiveBlock *live_blocks = NULL;
+size_t live_capacity = 0;
+size_t live_count = 0;
+
+AllocStats tag_stats[ALLOC_TAG_COUNT];
+AllocStats total_stats;
+bool printing_at_exit = false;
+
+const char *TAG_NAMES[ALLOC_TAG_COUNT] = {
+  "other", "body", "shape", "scene", "forcer", "collision", "render", "text"
+};
+
+size_t live_slot(void *ptr) {
+  // Blocks are at least 16-byte aligned, so the low bits carry no information
+  uint64_t hash = ((uintptr_t)ptr >> 4) * 0x9E3779B97F4A7C15ull;
+  return (size_t)(hash >> 32) & (live_capacity - 1);
+}
+
+void live_insert(LiveBlock block);
+
+void live_grow(void) {
+  LiveBlock *old_blocks = live_blocks;
+  size_t old_capacity = live_capacity;
+  live_capacity = old_capacity == 0 ? INITIAL_LIVE_CAPACITY : old_capacity * 2;
+  live_blocks = calloc(live_capacity, sizeof(LiveBlock));
+  assert(live_blocks);
+  live_count = 0;
+  for (size_t i = 0; i < old_capacity; i++) {
+    if (old_blocks[i].ptr != NULL) {
+      live_insert(old_blocks[i]);
+    }
+  }
+  free(old_blocks);
+}
+
+void live_insert(LiveBlock block) {
+  if (2 * (live_count + 1) > live_capacity) {
+    live_grow();
+  }
+  size_t slot = live_slot(block.ptr);
+  while (live_blocks[slot].ptr != NULL && live_blocks[slot].ptr != block.ptr) {
+    slot = (slot + 1) & (live_capacity - 1);
+  }
+  if (live_blocks[slot].ptr == NULL) {
+    live_count++;
+  }
+  live_blocks[slot] = block;
+}
+
+// Removes a block from the table, returning false if it was not tracked
+bool live_remove(void *ptr, LiveBlock *removed) {
+  if (live_capacity == 0) {
+    return false;
+  }
+  size_t slot = live_slot(ptr);
+  while (live_blocks[slot].ptr != ptr) {
+    if (live_blocks[slot].ptr == NULL) {
+      return false;
+    }
+    slot = (slot + 1) & (live_capacity - 1);
+  }
+  *removed = live_blocks[slot];
+  live_count--;
+
+  // Shift later blocks in the same run back, so lookups never stop early
+  size_t hole = slot;
+  size_t next = (hole + 1) & (live_capacity - 1);
+  while (live_blocks[next].ptr != NULL) {
+    size_t home = live_slot(live_blocks[next].ptr);
+    if (((next - home) & (live_capacity - 1)) >= ((next - hole) & (live_capacity - 1))) {
+      live_blocks[hole] = live_blocks[next];
+      hole = next;
+    }
+    next = (next + 1) & (live_capacity - 1);
+  }
+  live_blocks[hole].ptr = NULL;
+  return true;
+}
+
+void stats_add(AllocStats *stats, size_t size) {
+  stats->allocations++;
+  stats->bytes += size;
+  stats->live_bytes += size;
+  if (stats->live_bytes > stats->peak_live_bytes) {
+    stats->peak_live_bytes = stats->live_bytes;
+  }
+}
+
+void stats_remove(AllocStats *stats, size_t size) {
+  stats->frees++;
+  stats->live_bytes -= size;
+}
+
+void track_free(void *ptr) {
+  LiveBlock block;
+  if (live_remove(ptr, &block)) {
+    stats_remove(&tag_stats[block.tag], block.size);
+    stats_remove(&total_stats, block.size);
+  }
+}
+
+void track_allocation(AllocTag tag, void *ptr, size_t size) {
+  assert(tag < ALLOC_TAG_COUNT);
+  // A block that is still recorded at this address was freed untracked
+  track_free(ptr);
+  live_insert((LiveBlock){.ptr = ptr, .size = size, .tag = tag});
+  stats_add(&tag_stats[tag], size);
+  stats_add(&total_stats, size);
+}
+
+void *alloc_tracker_malloc(AllocTag tag, size_t size) {
+  void *ptr = malloc(size);
+  if (ptr != NULL) {
+    track_allocation(tag, ptr, size);
+  }
+  return ptr;
+}
+
+void *alloc_tracker_calloc(AllocTag tag, size_t count, size_t size) {
+  void *ptr = calloc(count, size);
+  if (ptr != NULL) {
+    track_allocation(tag, ptr, count * size);
+  }
+  return ptr;
+}
+
+void *alloc_tracker_realloc(AllocTag tag, void *ptr, size_t size) {
+  // The old block is looked up first, since its address is invalid afterwards
+  LiveBlock old_block;
+  bool was_tracked = ptr != NULL && live_remove(ptr, &old_block);
+  void *resized = realloc(ptr, size);
+  if (resized == NULL && size > 0) {
+    if (was_tracked) {
+      live_insert(old_block);
+    }
+    return NULL;
+  }
+  if (was_tracked) {
+    stats_remove(&tag_stats[old_block.tag], old_block.size);
+    stats_remove(&total_stats, old_block.size);
+  }
+  if (resized != NULL) {
+    track_allocation(tag, resized, size);
+  }
+  return resized;
+}
+
+void alloc_tracker_free(void *ptr) {
+  if (ptr != NULL) {
+    track_free(ptr);
+    free(ptr);
+  }
+}
+
+bool alloc_tracker_enabled(void) {
+#ifdef TRACK_ALLOCATIONS
+  return true;
+#else
+  return false;
+#endif
+}
+
+AllocStats alloc_tracker_get(AllocTag tag) {
+  assert(tag < ALLOC_TAG_COUNT);
+  return tag_stats[tag];
+}
+
+AllocStats alloc_tracker_total(void) {
+  return total_stats;
+}
+
+const char *alloc_tracker_tag_name(AllocTag tag) {
+  assert(tag < ALLOC_TAG_COUNT);
+  return TAG_NAMES[tag];
+}
+
+void print_stats(FILE *file, const char *name, AllocStats stats) {
+  fprintf(file, "%-10s %12zu %12zu %14zu %12zu %12zu\n",
+    name, stats.allocations, stats.frees, stats.bytes,
+    stats.live_bytes, stats.peak_live_bytes);
+}
+
+void alloc_tracker_print(FILE *file) {
+  fprintf(file, "%-10s %12s %12s %14s %12s %12s\n",
+    "tag", "allocations", "frees", "bytes", "live bytes", "peak live");
+  for (AllocTag tag = 0; tag < ALLOC_TAG_COUNT; tag++) {
+    print_stats(file, TAG_NAMES[tag], tag_stats[tag]);
+  }
+  print_stats(file, "total", total_stats);
+}
+
+void print_to_stderr(void) {
+  alloc_tracker_print(stderr);
+}
+
+void alloc_tracker_print_at_exit(void) {
+  if (alloc_tracker_enabled() && !printing_at_exit) {
+    printing_at_exit = true;
+    atexit(print_to_stderr);
+  }
+}
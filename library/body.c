@@ -1,68 +1,193 @@
+#define ALLOC_TAG ALLOC_BODY
 #include "body.h"
-#include "polygon.h"
+#include "alloc_tracker.h"
 #include <stdlib.h>
 #include <math.h>
 
 struct body {
-  List *shape;
+  // The shape's vertices relative to the centroid, before rotation.
+  // May be shared with other bodies.
+  Shape *shape;
+  // Cached world-space vertices, recomputed lazily when the body has moved
+  VectorArray world_shape;
+  bool world_shape_stale;
+  // Bounding box of world_shape, rebuilt along with it
+  Vector world_min;
+  Vector world_max;
+  // Cached world-space edge normals, which only change when the body rotates
+  VectorArray world_normals;
+  bool world_normals_stale;
+  double angle;
+  // cos and sin of angle, so the cache can be rebuilt without trigonometry
+  Vector rotation;
   void *info;
   FreeFunc info_freer;
   double mass;
+  BodyType type;
   RGBColor color;
   Vector centroid;
   Vector velocity;
+  // Where the body was at the start of the last tick, for rendering between ticks
+  Vector saved_centroid;
+  double saved_angle;
   Vector force;
   Vector impulse;
+  double linear_damping;
+  double quadratic_damping;
+  // The acceleration and dt of the last Velocity Verlet step,
+  // used to correct the velocity it predicted. last_dt is 0 if unused.
+  Vector last_acceleration;
+  double last_dt;
   bool to_remove;
+  bool asleep;
+  // How long the body has been moving slower than its scene's sleep speed
+  double rest_time;
+  size_t scene_index;
 };
 
 Body *body_init(List *shape, double mass, RGBColor color) {
-  Body* body = malloc(sizeof(Body));
-  body->shape = shape;
+  return body_init_with_info(shape, mass, color, (void*)list_init(0, TRACKED_FREE), (FreeFunc)list_free);
+}
+
+Body *body_init_with_info(List *shape, double mass, RGBColor color, void *info, FreeFunc info_freer) {
+  Shape *prototype = shape_init(shape);
+  Body *body = body_init_with_shape(prototype, mass, color, info, info_freer);
+  shape_release(prototype);
+  return body;
+}
+
+Body *body_init_with_shape(Shape *shape, double mass, RGBColor color, void *info, FreeFunc info_freer) {
+  Body* body = TRACKED_MALLOC(sizeof(Body));
   body->mass = mass;
+  body->type = BODY_DYNAMIC;
   body->color = color;
-  if (list_size(shape) > 0) {
-    body->centroid = polygon_centroid(shape);
-  }
-  else {
-    body->centroid = (Vector){.x = 0, .y = 0};
-  }
+  body->shape = shape_retain(shape);
+  body->centroid = shape_get_centroid(shape);
+  vector_array_init(&body->world_shape, shape_get_vertices(shape)->size);
+  body->world_shape_stale = true;
+  vector_array_init(&body->world_normals, 0);
+  body->world_normals_stale = true;
+  body->angle = 0;
+  body->rotation = (Vector){.x = 1, .y = 0};
+  body->saved_centroid = body->centroid;
+  body->saved_angle = 0;
   body->velocity = VEC_ZERO;
   body->force = VEC_ZERO;
   body->impulse = VEC_ZERO;
+  body->linear_damping = 0;
+  body->quadratic_damping = 0;
+  body->last_acceleration = VEC_ZERO;
+  body->last_dt = 0;
   body->to_remove = false;
-  body->info = (void*)list_init(0, free);
-  body->info_freer = (FreeFunc)list_free;
-  return body;
-}
-
-Body *body_init_with_info(List *shape, double mass, RGBColor color, void *info, FreeFunc info_freer) {
-  Body *body = body_init(shape, mass, color);
+  body->asleep = false;
+  body->rest_time = 0;
+  body->scene_index = 0;
   body->info = info;
   body->info_freer = info_freer;
   return body;
 }
 
 void body_free(Body *body) {
-  list_free(body->shape);
+  shape_release(body->shape);
+  vector_array_free(&body->world_shape);
+  vector_array_free(&body->world_normals);
   if (body->info_freer != NULL) {
     body->info_freer(body->info);
   }
-  free(body);
+  TRACKED_FREE(body);
 }
 
 List *body_get_shape(Body *body) {
-  List *shape_copy = list_init(list_size(body->shape), free);
-  for (int i = 0; i < list_size(body->shape); i++) {
-    Vector to_add = *(Vector*)list_get(body->shape, i);
-    Vector *to_add_pointer = malloc(sizeof(Vector));
-    to_add_pointer->x = to_add.x;
-    to_add_pointer->y = to_add.y;
+  const VectorArray *vertices = body_get_vertices(body);
+  List *shape_copy = list_init(vertices->size, TRACKED_FREE);
+  for (size_t i = 0; i < vertices->size; i++) {
+    Vector *to_add_pointer = TRACKED_MALLOC(sizeof(Vector));
+    *to_add_pointer = vertices->data[i];
     list_add(shape_copy, (void*)to_add_pointer);
   }
   return shape_copy;
 }
 
+const VectorArray *body_get_vertices(Body *body) {
+  if (body->world_shape_stale) {
+    const VectorArray *local_shape = shape_get_vertices(body->shape);
+    Vector c = body->rotation;
+    vector_array_reserve(&body->world_shape, local_shape->size);
+    for (size_t i = 0; i < local_shape->size; i++) {
+      Vector local = local_shape->data[i];
+      body->world_shape.data[i] = (Vector){
+        .x = body->centroid.x + c.x * local.x - c.y * local.y,
+        .y = body->centroid.y + c.y * local.x + c.x * local.y
+      };
+    }
+    body->world_shape.size = local_shape->size;
+    body->world_shape_stale = false;
+
+    // Rotating the corners of the local bounding box would over-estimate it,
+    // so the box is taken from the world vertices instead
+    Vector min = local_shape->size > 0 ? body->world_shape.data[0] : body->centroid;
+    Vector max = min;
+    for (size_t i = 1; i < local_shape->size; i++) {
+      Vector vertex = body->world_shape.data[i];
+      min.x = fmin(min.x, vertex.x);
+      min.y = fmin(min.y, vertex.y);
+      max.x = fmax(max.x, vertex.x);
+      max.y = fmax(max.y, vertex.y);
+    }
+    body->world_min = min;
+    body->world_max = max;
+  }
+  return &body->world_shape;
+}
+
+void body_save_state(Body *body) {
+  body->saved_centroid = body->centroid;
+  body->saved_angle = body->angle;
+}
+
+void body_get_interpolated_vertices(Body *body, double alpha, VectorArray *vertices) {
+  const VectorArray *local_shape = shape_get_vertices(body->shape);
+  Vector centroid = vec_add(
+    body->saved_centroid,
+    vec_multiply(alpha, vec_subtract(body->centroid, body->saved_centroid))
+  );
+  double angle = body->saved_angle + alpha * (body->angle - body->saved_angle);
+  Vector c = angle == body->angle ? body->rotation : (Vector){.x = cos(angle), .y = sin(angle)};
+  vector_array_reserve(vertices, local_shape->size);
+  for (size_t i = 0; i < local_shape->size; i++) {
+    Vector local = local_shape->data[i];
+    vertices->data[i] = (Vector){
+      .x = centroid.x + c.x * local.x - c.y * local.y,
+      .y = centroid.y + c.y * local.x + c.x * local.y
+    };
+  }
+  vertices->size = local_shape->size;
+}
+
+const VectorArray *body_get_normals(Body *body) {
+  if (body->world_normals_stale) {
+    const VectorArray *local_normals = shape_get_normals(body->shape);
+    Vector c = body->rotation;
+    vector_array_reserve(&body->world_normals, local_normals->size);
+    for (size_t i = 0; i < local_normals->size; i++) {
+      Vector local = local_normals->data[i];
+      body->world_normals.data[i] = (Vector){
+        .x = c.x * local.x - c.y * local.y,
+        .y = c.y * local.x + c.x * local.y
+      };
+    }
+    body->world_normals.size = local_normals->size;
+    body->world_normals_stale = false;
+  }
+  return &body->world_normals;
+}
+
+void body_get_bounds(Body *body, Vector *min, Vector *max) {
+  body_get_vertices(body);
+  *min = body->world_min;
+  *max = body->world_max;
+}
+
 Vector body_get_centroid(Body *body) {
   return body->centroid;
 }
@@ -83,29 +208,75 @@ double body_get_mass(Body *body) {
   return body->mass;
 }
 
+Shape *body_get_prototype(Body *body) {
+  return body->shape;
+}
+
+double body_get_rotation(Body *body) {
+  return body->angle;
+}
+
 void body_set_centroid(Body *body, Vector x) {
-  Vector old_centroid = body->centroid;
+  if (x.x == body->centroid.x && x.y == body->centroid.y) {
+    return;
+  }
   body->centroid = x;
-  polygon_translate(body->shape, vec_subtract(x, old_centroid));
+  body->world_shape_stale = true;
+  if (body->asleep) {
+    body_wake(body);
+  }
 }
 
 void body_set_velocity(Body *body, Vector v) {
+  if (body->asleep && (v.x != 0 || v.y != 0)) {
+    body_wake(body);
+  }
   body->velocity = v;
 }
 
 void body_set_rotation(Body *body, double angle) {
-  polygon_rotate(body->shape, angle, body->centroid);
+  if (angle == body->angle) {
+    return;
+  }
+  body->angle = angle;
+  body->rotation = (Vector){.x = cos(angle), .y = sin(angle)};
+  body->world_shape_stale = true;
+  body->world_normals_stale = true;
+}
+
+BodyType body_get_type(Body *body) {
+  return body->type;
+}
+
+void body_set_type(Body *body, BodyType type) {
+  body->type = type;
 }
 
 void body_add_force(Body *body, Vector force) {
+  if (body->asleep && (force.x != 0 || force.y != 0)) {
+    body_wake(body);
+  }
   body->force = vec_add(body->force, force);
 }
 
 void body_add_impulse(Body *body, Vector impulse) {
+  if (body->asleep && (impulse.x != 0 || impulse.y != 0)) {
+    body_wake(body);
+  }
   body->impulse = vec_add(body->impulse, impulse);
 }
 
 void body_tick(Body *body, double dt) {
+  if (body->type == BODY_KINEMATIC) {
+    body_tick_kinematic(body, dt);
+    return;
+  }
+  if (body->type == BODY_STATIC) {
+    body->impulse = VEC_ZERO;
+    body->force = VEC_ZERO;
+    return;
+  }
+
   Vector init_velocity = body->velocity;
 
   // p = mv
@@ -122,12 +293,160 @@ void body_tick(Body *body, double dt) {
   body->impulse = VEC_ZERO;
   body->force = VEC_ZERO;
 
+  body->last_dt = 0;
+
   Vector average_velocity = vec_multiply(.5, vec_add(init_velocity, body->velocity));
 
   Vector translation = vec_multiply(dt, average_velocity);
   body_set_centroid(body, vec_add(body->centroid, translation));
 }
 
+Vector body_get_force(Body *body) {
+  return body->force;
+}
+
+Vector body_get_impulse(Body *body) {
+  return body->impulse;
+}
+
+void body_set_accumulated(Body *body, Vector force, Vector impulse) {
+  body->force = force;
+  body->impulse = impulse;
+}
+
+Vector body_take_acceleration(Body *body) {
+  if (body->mass != INFINITY) {
+    body->velocity = vec_add(body->velocity, vec_multiply(1 / body->mass, body->impulse));
+  }
+  Vector acceleration = vec_multiply(1 / body->mass, body->force);
+  body->impulse = VEC_ZERO;
+  body->force = VEC_ZERO;
+  return acceleration;
+}
+
+void body_tick_symplectic_euler(Body *body, double dt) {
+  if (body->type != BODY_DYNAMIC) {
+    body_tick(body, dt);
+    return;
+  }
+  Vector acceleration = body_take_acceleration(body);
+  body->velocity = vec_add(body->velocity, vec_multiply(dt, acceleration));
+  body->last_dt = 0;
+  body_set_centroid(body, vec_add(body->centroid, vec_multiply(dt, body->velocity)));
+}
+
+void body_tick_verlet(Body *body, double dt) {
+  if (body->type != BODY_DYNAMIC) {
+    body_tick(body, dt);
+    return;
+  }
+  Vector acceleration = body_take_acceleration(body);
+  // The last step predicted v + a dt; Velocity Verlet uses the average of
+  // the accelerations at both ends of the step, now that the second is known
+  Vector correction = vec_subtract(acceleration, body->last_acceleration);
+  body->velocity = vec_add(body->velocity, vec_multiply(.5 * body->last_dt, correction));
+
+  Vector translation = vec_add(
+    vec_multiply(dt, body->velocity), vec_multiply(.5 * dt * dt, acceleration)
+  );
+  body->velocity = vec_add(body->velocity, vec_multiply(dt, acceleration));
+  body->last_acceleration = acceleration;
+  body->last_dt = dt;
+  body_set_centroid(body, vec_add(body->centroid, translation));
+}
+
+void body_set_damping(Body *body, double linear, double quadratic) {
+  body->linear_damping = linear;
+  body->quadratic_damping = quadratic;
+}
+
+double body_get_linear_damping(Body *body) {
+  return body->linear_damping;
+}
+
+double body_get_quadratic_damping(Body *body) {
+  return body->quadratic_damping;
+}
+
+bool body_has_damping(Body *body) {
+  return body->linear_damping != 0 || body->quadratic_damping != 0;
+}
+
+Vector body_get_damping_force(Body *body) {
+  if (body->mass == INFINITY || (body->linear_damping == 0 && body->quadratic_damping == 0)) {
+    return VEC_ZERO;
+  }
+  double speed = sqrt(vec_dot(body->velocity, body->velocity));
+  return vec_multiply(-(body->linear_damping + body->quadratic_damping * speed), body->velocity);
+}
+
+void body_apply_damping(Body *body, double dt) {
+  if (body->linear_damping == 0 && body->quadratic_damping == 0) {
+    return;
+  }
+  double speed = sqrt(vec_dot(body->velocity, body->velocity));
+  if (body->mass == INFINITY || speed == 0) {
+    return;
+  }
+  double a = body->linear_damping / body->mass;
+  double b = body->quadratic_damping / body->mass;
+  double new_speed;
+  if (b == 0) {
+    new_speed = speed * exp(-a * dt);
+  }
+  else if (a == 0) {
+    new_speed = speed / (1 + b * speed * dt);
+  }
+  else {
+    double decay = exp(-a * dt);
+    new_speed = a * speed * decay / (a + b * speed * (1 - decay));
+  }
+  body->velocity = vec_multiply(new_speed / speed, body->velocity);
+}
+
+void body_tick_kinematic(Body *body, double dt) {
+  body->impulse = VEC_ZERO;
+  body->force = VEC_ZERO;
+  body_set_centroid(body, vec_add(body->centroid, vec_multiply(dt, body->velocity)));
+}
+
+double body_update_rest_time(Body *body, double max_speed, double dt) {
+  if (!body->asleep) {
+    if (vec_dot(body->velocity, body->velocity) < max_speed * max_speed) {
+      body->rest_time += dt;
+    }
+    else {
+      body->rest_time = 0;
+    }
+  }
+  return body->rest_time;
+}
+
+void body_sleep(Body *body) {
+  body_save_state(body);
+  body->asleep = true;
+  body->velocity = VEC_ZERO;
+  body->force = VEC_ZERO;
+  body->impulse = VEC_ZERO;
+}
+
+void body_wake(Body *body) {
+  body->asleep = false;
+  body->rest_time = 0;
+}
+
+bool body_is_asleep(Body *body) {
+  return body->asleep;
+}
+
+void body_set_scene_index(Body *body, size_t index) {
+  body->scene_index = index;
+}
+
+size_t body_get_scene_index(Body *body) {
+  return body->scene_index;
+}
+
 void body_remove(Body *body) {
   body->to_remove = true;
 }
@@ -1,105 +1,128 @@
-#include "forces.h"
+#define ALLOC_TAG ALLOC_COLLISION
+#include "collision.h"
 #include "polygon.h"
 #include <math.h>
 #include <stdlib.h>
-#include <stdio.h>
 
-#define BOUNDING_BOX_WIDTH 150
+// The number of calls to find_polygon_collision(), for collision_test_count()
+size_t collision_tests = 0;
 
-double max(double a, double b) {
-  if (a > b) {
-    return a;
+void project_polygon(const VectorArray *shape, Vector axis, double *min, double *max) {
+  *min = INFINITY;
+  *max = -INFINITY;
+  for (size_t i = 0; i < shape->size; i++) {
+    double projection = vec_dot(shape->data[i], axis);
+    *min = fmin(*min, projection);
+    *max = fmax(*max, projection);
   }
-  return b;
 }
 
-double min(double a, double b) {
-  if (a < b) {
-    return a;
-  }
-  return b;
-}
+// Updates the minimum overlap over the given axes.
+// Returns false as soon as one of the axes separates the shapes.
+bool find_min_overlap(
+  const VectorArray *axes, const VectorArray *shape1, const VectorArray *shape2,
+  double *min_overlap, Vector *collision_axis
+) {
+  for (size_t i = 0; i < axes->size; i++) {
+    Vector axis = axes->data[i];
+    // Zero-length edges (repeated vertices) have no normal to test
+    if (axis.x == 0 && axis.y == 0) {
+      continue;
+    }
+    double min1, max1, min2, max2;
+    project_polygon(shape1, axis, &min1, &max1);
+    project_polygon(shape2, axis, &min2, &max2);
 
-void get_projection(List* points, Vector line, Vector **min, Vector **max) {
-  for (size_t i = 0; i < list_size(points); i++) {
-    Vector point = vec_multiply(vec_dot(*((Vector*)list_get(points, i)), line), line);
-    if (point.x < (*min)->x || (point.x == (*min)->x && point.y < (*min)->y)) {
-      **min = point;
+    double overlap = fmin(max1, max2) - fmax(min1, min2);
+    if (overlap <= 0) {
+      return false;
     }
-    if (point.x > (*max)->x || (point.x == (*max)->x && point.y > (*max)->y)) {
-      **max = point;
+    if (overlap < *min_overlap) {
+      *min_overlap = overlap;
+      *collision_axis = axis;
     }
   }
+  return true;
 }
 
-double get_line_overlap(Vector min1, Vector min2, Vector max1, Vector max2) {
-  Vector trans = vec_subtract(max2, min1);
-  Vector anchor = vec_subtract(min1, trans);
-  double min1_1d = distance(anchor, min1);
-  double min2_1d = distance(anchor, min2);
-  double max1_1d = distance(anchor, max1);
-  double max2_1d = distance(anchor, max2);
+CollisionInfo find_polygon_collision(
+  const VectorArray *shape1, const VectorArray *normals1, Vector centroid1,
+  const VectorArray *shape2, const VectorArray *normals2, Vector centroid2
+) {
+  collision_tests++;
+  CollisionInfo no_collision = {.collided = false, .axis = VEC_ZERO, .overlap = 0};
+  double min_overlap = INFINITY;
+  Vector collision_axis = VEC_ZERO;
+
+  if (!find_min_overlap(normals1, shape1, shape2, &min_overlap, &collision_axis) ||
+      !find_min_overlap(normals2, shape1, shape2, &min_overlap, &collision_axis)) {
+    return no_collision;
+  }
+  if (min_overlap == INFINITY) {
+    return no_collision;
+  }
 
-  return max(0, min(max1_1d, max2_1d) - max(min1_1d, min2_1d));
+  // Make the axis point from shape1 towards shape2
+  if (vec_dot(vec_subtract(centroid2, centroid1), collision_axis) < 0) {
+    collision_axis = vec_negate(collision_axis);
+  }
+  return (CollisionInfo){
+    .collided = true, .axis = collision_axis, .overlap = min_overlap
+  };
 }
 
-double get_projection_overlap(Vector axis, List *shape1, List *shape2) {
-  Vector *min1 = malloc(sizeof(Vector));
-  min1->x = INFINITY;
-  min1->y = INFINITY;
-  Vector *max1 = malloc(sizeof(Vector));
-  max1->x = -INFINITY;
-  max1->y = -INFINITY;
-  Vector *min2 = malloc(sizeof(Vector));
-  min2->x = INFINITY;
-  min2->y = INFINITY;
-  Vector *max2 = malloc(sizeof(Vector));
-  max2->x = -INFINITY;
-  max2->y = -INFINITY;
-
-  get_projection(shape1, axis, &min1, &max1);
-  get_projection(shape2, axis, &min2, &max2);
+bool bounds_overlap(Vector min1, Vector max1, Vector min2, Vector max2) {
+  return min1.x < max2.x && min2.x < max1.x && min1.y < max2.y && min2.y < max1.y;
+}
 
-  return get_line_overlap(*min1, *min2, *max1, *max2);
+// Copies a list of vertices into an array, and computes its normals and metrics
+PolygonMetrics polygon_from_list(List *shape, VectorArray *vertices, VectorArray *normals) {
+  size_t n = list_size(shape);
+  vector_array_init(vertices, n);
+  for (size_t i = 0; i < n; i++) {
+    vector_array_add(vertices, *(Vector*)list_get(shape, i));
+  }
+  PolygonMetrics metrics = polygon_metrics(vertices->data, n);
+  vector_array_init(normals, n);
+  polygon_edge_normals(vertices->data, n, metrics.area < 0 ? -1 : 1, normals->data);
+  normals->size = n;
+  return metrics;
 }
 
 CollisionInfo find_collision(List *shape1, List *shape2) {
-  if(fabs(polygon_centroid(shape1).x - polygon_centroid(shape2).x) <= BOUNDING_BOX_WIDTH) {
-    double min_overlap = INFINITY;
-    Vector collision_axis;
-
-    for (size_t i = 0; i < list_size(shape1); i++) {
-      Vector side;
-      if (i == list_size(shape1) - 1) {
-        side = vec_subtract(*((Vector*)list_get(shape1, 0)), *((Vector*)list_get(shape1, i)));
-      }
-      else {
-        side = vec_subtract(*((Vector*)list_get(shape1, i + 1)), *((Vector*)list_get(shape1, i)));
-      }
-
-      Vector unit_parallel = unit_vector(side);
-      double par_overlap = get_projection_overlap(unit_parallel, shape1, shape2);
+  VectorArray vertices1, normals1, vertices2, normals2;
+  PolygonMetrics metrics1 = polygon_from_list(shape1, &vertices1, &normals1);
+  PolygonMetrics metrics2 = polygon_from_list(shape2, &vertices2, &normals2);
+
+  CollisionInfo info = {.collided = false, .axis = VEC_ZERO, .overlap = 0};
+  if (bounds_overlap(metrics1.min, metrics1.max, metrics2.min, metrics2.max)) {
+    info = find_polygon_collision(
+      &vertices1, &normals1, metrics1.centroid,
+      &vertices2, &normals2, metrics2.centroid
+    );
+  }
 
-      if (par_overlap == 0 /*|| per_overlap == 0*/) {
-        return (CollisionInfo){.collided = false, .axis = VEC_ZERO};
-      }
-      else if (par_overlap < min_overlap) {
-          min_overlap = par_overlap;
-          collision_axis = unit_parallel;
-      }
-    }
+  vector_array_free(&vertices1);
+  vector_array_free(&normals1);
+  vector_array_free(&vertices2);
+  vector_array_free(&normals2);
+  return info;
+}
 
+size_t collision_test_count(void) {
+  return collision_tests;
+}
 
-    // Check direction of collision_axis
-    Vector oneToTwo = vec_subtract(polygon_centroid(shape2), polygon_centroid(shape1));
-    if ((oneToTwo.x < 0 && collision_axis.x > 0) ||
-        (oneToTwo.x > 0 && collision_axis.x < 0) ||
-        (oneToTwo.y < 0 && collision_axis.y > 0) ||
-        (oneToTwo.y > 0 && collision_axis.y < 0)) {
-          collision_axis = vec_negate(collision_axis);
-        }
+CollisionInfo find_body_collision(Body *body1, Body *body2) {
+  Vector min1, max1, min2, max2;
+  body_get_bounds(body1, &min1, &max1);
+  body_get_bounds(body2, &min2, &max2);
+  if (!bounds_overlap(min1, max1, min2, max2)) {
+    return (CollisionInfo){.collided = false, .axis = VEC_ZERO, .overlap = 0};
+  }
 
-        return (CollisionInfo){.collided = true, .axis = collision_axis};
-}
-  return (CollisionInfo){.collided = false, .axis = VEC_ZERO};
+  return find_polygon_collision(
+    body_get_vertices(body1), body_get_normals(body1), body_get_centroid(body1),
+    body_get_vertices(body2), body_get_normals(body2), body_get_centroid(body2)
+  );
 }
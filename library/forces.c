@@ -1,10 +1,30 @@
+#define ALLOC_TAG ALLOC_FORCER
 #include "forces.h"
+#include "alloc_tracker.h"
 #include "list.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <assert.h>
 #include <math.h>
 
 #define GRAVITY_LIMIT 1
+// Deeper than this, a gravity group's quadtree keeps several bodies per leaf,
+// so bodies at the same point cannot split it forever
+#define GRAVITY_TREE_MAX_DEPTH 32
+#define NO_NODE ((size_t)-1)
+// Gravity groups with at most this many bodies skip the quadtree
+// and compute every pair exactly
+#define GRAVITY_DIRECT_MAX 1024
+// The all-pairs kernel works on square tiles of this many bodies,
+// so each tile's positions and forces stay in the L1 cache
+#define GRAVITY_TILE 256
+// The number of independent sums each row of the kernel keeps,
+// so the compiler can vectorize it without reordering a single sum
+#define GRAVITY_LANES 8
+// The fraction of the overlap between two bodies corrected each tick
+#define CONTACT_CORRECTION 0.8
+// How closely a contact's normal must match last tick's to reuse its impulse
+#define CONTACT_WARM_START_ALIGNMENT 0.99
 
 struct gravity_params {
   double G;
@@ -12,17 +32,64 @@ struct gravity_params {
   Body *body2;
 };
 
+// A square cell of a gravity group's quadtree
+typedef struct {
+  Vector min;
+  double size;
+  double mass;
+  // The sum of mass times position, and then the center of mass
+  // once the tree is built
+  Vector center;
+  // The first of the cell's 4 consecutive children, or NO_NODE for a leaf
+  size_t children;
+  // The node after this one and all its descendants in depth-first order
+  // (its next sibling, or an ancestor's), or NO_NODE after the last node,
+  // so the tree can be walked without a stack
+  size_t next;
+  // The first body in a leaf, linked through the group's next_body
+  size_t first_body;
+} GravityNode;
+
+DEFINE_ARRAY(GravityNodeArray, gravity_node_array, GravityNode)
+DEFINE_ARRAY(IndexArray, index_array, size_t)
+DEFINE_ARRAY(DoubleArray, double_array, double)
+
+struct gravity_group {
+  double G;
+  double theta;
+  size_t direct_max;
+  BodyArray bodies;
+  // Rebuilt every tick: the bodies' positions, masses and the forces on them,
+  // each stored contiguously, and the quadtree over them
+  DoubleArray xs;
+  DoubleArray ys;
+  DoubleArray masses;
+  DoubleArray force_xs;
+  DoubleArray force_ys;
+  IndexArray next_body;
+  GravityNodeArray nodes;
+};
+
+struct uniform_gravity_params {
+  const GravityField *field;
+  Body *body;
+  // The acceleration last applied, so that changing the field wakes the body
+  Vector applied;
+};
+
+struct half_plane_params {
+  Vector point;
+  Vector normal;
+  double e;
+  Body *body;
+};
+
 struct spring_params {
   double k;
   Body *body1;
   Body *anchor;
 };
 
-struct drag_params {
-  double gamma;
-  Body *body;
-};
-
 struct coll_params {
   Body *body1;
   Body *body2;
@@ -32,13 +99,21 @@ struct phys_coll_params {
   double e;
   Body *body1;
   Body *body2;
-  bool col_slt;
+  // Contact state found by PhysicsCollisionPrepare() each tick
+  bool touching;
+  Vector normal;
+  double normal_mass;
+  // The relative normal velocity the contact should end up with
+  double target_speed;
+  // The total normal impulse applied so far, kept across ticks for warm starting
+  double accumulated;
 };
 
 struct gen_coll_params {
   Body *body1;
   Body *body2;
   void *aux;
+  FreeFunc aux_freer;
   CollisionHandler ch;
   bool col_slt;
 };
@@ -62,14 +137,13 @@ Vector unit_vector(Vector v) {
 }
 
 void create_newtonian_gravity(Scene *scene, double G, Body *body1, Body *body2) {
-  GravityParams *aux = malloc(sizeof(GravityParams));
+  Body *bodies[] = {body1, body2};
+  GravityParams *aux = scene_add_batched_force_creator(
+    scene, GravityBatchForceCreator, sizeof(GravityParams), bodies, 2, NULL
+  );
   aux->G = G;
   aux->body1 = body1;
   aux->body2 = body2;
-  List *bodies = list_init(2, free);
-  list_add(bodies, (void*)body1);
-  list_add(bodies, (void*)body2);
-  scene_add_bodies_force_creator(scene, (ForceCreator)GravityForceCreator, (void*)aux, bodies, (FreeFunc)free);
 }
 
 Vector get_gravity_from(Body *this, Body *other, double G) {
@@ -102,15 +176,383 @@ void GravityForceCreator(void *aux) {
   body_add_force(body2, vec_negate(force_on_1));
 }
 
+void GravityBatchForceCreator(void *params, size_t count) {
+  GravityParams *gravities = (GravityParams*)params;
+  for (size_t i = 0; i < count; i++) {
+    GravityForceCreator(&gravities[i]);
+  }
+}
+
+void gravity_group_free(GravityGroup *group) {
+  body_array_free(&group->bodies);
+  double_array_free(&group->xs);
+  double_array_free(&group->ys);
+  double_array_free(&group->masses);
+  double_array_free(&group->force_xs);
+  double_array_free(&group->force_ys);
+  index_array_free(&group->next_body);
+  gravity_node_array_free(&group->nodes);
+  TRACKED_FREE(group);
+}
+
+bool gravity_group_body_is_removed(Body **body) {
+  return body_is_removed(*body);
+}
+
+void GravityGroupPrune(void *aux) {
+  GravityGroup *group = (GravityGroup*)aux;
+  body_array_remove_if(&group->bodies, gravity_group_body_is_removed, NULL, false);
+}
+
+GravityGroup *create_gravity_group(Scene *scene, double G, double theta) {
+  GravityGroup *group = TRACKED_MALLOC(sizeof(GravityGroup));
+  assert(group);
+  group->G = G;
+  group->theta = theta;
+  group->direct_max = GRAVITY_DIRECT_MAX;
+  body_array_init(&group->bodies, 0);
+  double_array_init(&group->xs, 0);
+  double_array_init(&group->ys, 0);
+  double_array_init(&group->masses, 0);
+  double_array_init(&group->force_xs, 0);
+  double_array_init(&group->force_ys, 0);
+  index_array_init(&group->next_body, 0);
+  gravity_node_array_init(&group->nodes, 0);
+  scene_add_group_force_creator(
+    scene, GravityGroupForceCreator, GravityGroupPrune, group,
+    &group->bodies, (FreeFunc)gravity_group_free
+  );
+  return group;
+}
+
+void gravity_group_add(GravityGroup *group, Body *body) {
+  body_array_add(&group->bodies, body);
+}
+
+void gravity_group_set_direct_max(GravityGroup *group, size_t max_bodies) {
+  group->direct_max = max_bodies;
+}
+
+size_t gravity_group_size(GravityGroup *group) {
+  size_t size = 0;
+  for (size_t i = 0; i < group->bodies.size; i++) {
+    if (!body_is_removed(group->bodies.data[i])) {
+      size++;
+    }
+  }
+  return size;
+}
+
+GravityNode gravity_node(Vector min, double size) {
+  return (GravityNode){
+    .min = min, .size = size, .mass = 0, .center = VEC_ZERO,
+    .children = NO_NODE, .next = NO_NODE, .first_body = NO_NODE
+  };
+}
+
+size_t gravity_node_quadrant(const GravityNode *node, Vector position) {
+  double half = node->size / 2;
+  return (position.x >= node->min.x + half) + 2 * (position.y >= node->min.y + half);
+}
+
+// Turns a leaf holding one body into a cell with 4 children
+void gravity_tree_split(GravityGroup *group, size_t node) {
+  size_t children = group->nodes.size;
+  GravityNode parent = group->nodes.data[node];
+  double half = parent.size / 2;
+  for (size_t quadrant = 0; quadrant < 4; quadrant++) {
+    Vector min = {
+      .x = parent.min.x + (quadrant & 1 ? half : 0),
+      .y = parent.min.y + (quadrant & 2 ? half : 0)
+    };
+    gravity_node_array_add(&group->nodes, gravity_node(min, half));
+  }
+
+  size_t body = parent.first_body;
+  Vector position = {group->xs.data[body], group->ys.data[body]};
+  double mass = group->masses.data[body];
+  GravityNode *child = &group->nodes.data[children + gravity_node_quadrant(&parent, position)];
+  child->mass = mass;
+  child->center = vec_multiply(mass, position);
+  child->first_body = body;
+
+  group->nodes.data[node].children = children;
+  group->nodes.data[node].first_body = NO_NODE;
+}
+
+void gravity_tree_insert(GravityGroup *group, size_t body) {
+  Vector position = {group->xs.data[body], group->ys.data[body]};
+  double mass = group->masses.data[body];
+  size_t node = 0;
+  for (size_t depth = 0; ; depth++) {
+    GravityNode *curr = &group->nodes.data[node];
+    curr->mass += mass;
+    curr->center = vec_add(curr->center, vec_multiply(mass, position));
+    if (curr->children == NO_NODE) {
+      if (curr->first_body == NO_NODE || depth == GRAVITY_TREE_MAX_DEPTH) {
+        group->next_body.data[body] = curr->first_body;
+        curr->first_body = body;
+        return;
+      }
+      gravity_tree_split(group, node);
+      curr = &group->nodes.data[node];
+    }
+    node = curr->children + gravity_node_quadrant(curr, position);
+  }
+}
+
+void gravity_tree_build(GravityGroup *group) {
+  size_t n = group->bodies.size;
+  Vector min = {group->xs.data[0], group->ys.data[0]};
+  Vector max = min;
+  for (size_t i = 1; i < n; i++) {
+    Vector position = {group->xs.data[i], group->ys.data[i]};
+    min.x = fmin(min.x, position.x);
+    min.y = fmin(min.y, position.y);
+    max.x = fmax(max.x, position.x);
+    max.y = fmax(max.y, position.y);
+  }
+
+  gravity_node_array_clear(&group->nodes);
+  gravity_node_array_add(&group->nodes, gravity_node(min, fmax(max.x - min.x, max.y - min.y)));
+  index_array_reserve(&group->next_body, n);
+  for (size_t i = 0; i < n; i++) {
+    gravity_tree_insert(group, i);
+  }
+  // Children always come after their parent, so each node's next is known
+  // by the time its children are reached
+  GravityNode *nodes = group->nodes.data;
+  for (size_t i = 0; i < group->nodes.size; i++) {
+    GravityNode *node = &nodes[i];
+    if (node->mass > 0) {
+      node->center = vec_multiply(1 / node->mass, node->center);
+    }
+    if (node->children != NO_NODE) {
+      for (size_t quadrant = 0; quadrant < 3; quadrant++) {
+        nodes[node->children + quadrant].next = node->children + quadrant + 1;
+      }
+      nodes[node->children + 3].next = node->next;
+    }
+  }
+}
+
+// Adds the force from a mass at displacement (dx, dy) to (force_x, force_y)
+void gravity_tree_add(
+  double G_mass, double mass, double dx, double dy, double *force_x, double *force_y
+) {
+  double r2 = dx * dx + dy * dy;
+  if (r2 < GRAVITY_LIMIT * GRAVITY_LIMIT) {
+    return;
+  }
+  double scale = G_mass * mass / (r2 * sqrt(r2));
+  *force_x += scale * dx;
+  *force_y += scale * dy;
+}
+
+Vector gravity_tree_force(GravityGroup *group, size_t body) {
+  const GravityNode *nodes = group->nodes.data;
+  const double *xs = group->xs.data;
+  const double *ys = group->ys.data;
+  const double *masses = group->masses.data;
+  const size_t *next_body = group->next_body.data;
+  double x = xs[body];
+  double y = ys[body];
+  double G_mass = group->G * masses[body];
+  double theta2 = group->theta * group->theta;
+  double force_x = 0, force_y = 0;
+  size_t index = 0;
+  while (index != NO_NODE) {
+    const GravityNode *node = &nodes[index];
+    if (node->mass == 0) {
+      index = node->next;
+      continue;
+    }
+    double dx = node->center.x - x;
+    double dy = node->center.y - y;
+    if (node->children == NO_NODE) {
+      size_t first = node->first_body;
+      // A leaf with one body is just that body, at the leaf's center of mass
+      if (next_body[first] == NO_NODE) {
+        if (first != body) {
+          gravity_tree_add(G_mass, node->mass, dx, dy, &force_x, &force_y);
+        }
+      }
+      else {
+        for (size_t other = first; other != NO_NODE; other = next_body[other]) {
+          if (other != body) {
+            gravity_tree_add(
+              G_mass, masses[other], xs[other] - x, ys[other] - y, &force_x, &force_y
+            );
+          }
+        }
+      }
+      index = node->next;
+      continue;
+    }
+    // size / distance < theta, without the square root
+    if (node->size * node->size < theta2 * (dx * dx + dy * dy)) {
+      gravity_tree_add(G_mass, node->mass, dx, dy, &force_x, &force_y);
+      index = node->next;
+      continue;
+    }
+    index = node->children;
+  }
+  return (Vector){force_x, force_y};
+}
+
+// The force on body i from body j per unit of displacement between them,
+// without the branch of gravity_tree_add() so it can be vectorized.
+// forces.c is built with -fno-math-errno and -fno-trapping-math,
+// so sqrt() needs no call and the division can be done for every pair.
+double gravity_pair_scale(double G_mass_i, double mass_j, double dx, double dy) {
+  double r2 = dx * dx + dy * dy;
+  double inverse_r = 1 / sqrt(r2);
+  double scale = G_mass_i * mass_j * inverse_r * inverse_r * inverse_r;
+  return r2 < GRAVITY_LIMIT * GRAVITY_LIMIT ? 0 : scale;
+}
+
+// Applies the forces between body i and bodies start to end - 1 to both sides
+void gravity_direct_row(GravityGroup *group, size_t i, size_t start, size_t end) {
+  const double *restrict xs = group->xs.data;
+  const double *restrict ys = group->ys.data;
+  const double *restrict masses = group->masses.data;
+  double *restrict force_xs = group->force_xs.data;
+  double *restrict force_ys = group->force_ys.data;
+  double x = xs[i];
+  double y = ys[i];
+  double G_mass = group->G * masses[i];
+  double sum_x[GRAVITY_LANES] = {0};
+  double sum_y[GRAVITY_LANES] = {0};
+  size_t j = start;
+  for (; j + GRAVITY_LANES <= end; j += GRAVITY_LANES) {
+    double pair_xs[GRAVITY_LANES];
+    double pair_ys[GRAVITY_LANES];
+    for (size_t lane = 0; lane < GRAVITY_LANES; lane++) {
+      double dx = xs[j + lane] - x;
+      double dy = ys[j + lane] - y;
+      double scale = gravity_pair_scale(G_mass, masses[j + lane], dx, dy);
+      pair_xs[lane] = scale * dx;
+      pair_ys[lane] = scale * dy;
+      sum_x[lane] += pair_xs[lane];
+      sum_y[lane] += pair_ys[lane];
+    }
+    // The equal and opposite forces, kept out of the loop above
+    // so that it only writes to its own lanes
+    for (size_t lane = 0; lane < GRAVITY_LANES; lane++) {
+      force_xs[j + lane] -= pair_xs[lane];
+      force_ys[j + lane] -= pair_ys[lane];
+    }
+  }
+  for (; j < end; j++) {
+    double dx = xs[j] - x;
+    double dy = ys[j] - y;
+    double scale = gravity_pair_scale(G_mass, masses[j], dx, dy);
+    sum_x[0] += scale * dx;
+    sum_y[0] += scale * dy;
+    force_xs[j] -= scale * dx;
+    force_ys[j] -= scale * dy;
+  }
+  for (size_t lane = 0; lane < GRAVITY_LANES; lane++) {
+    force_xs[i] += sum_x[lane];
+    force_ys[i] += sum_y[lane];
+  }
+}
+
+// Computes every pair once, applying equal and opposite forces to both bodies
+void gravity_direct_forces(GravityGroup *group) {
+  size_t n = group->bodies.size;
+  for (size_t tile_i = 0; tile_i < n; tile_i += GRAVITY_TILE) {
+    size_t end_i = tile_i + GRAVITY_TILE < n ? tile_i + GRAVITY_TILE : n;
+    for (size_t tile_j = tile_i; tile_j < n; tile_j += GRAVITY_TILE) {
+      size_t end_j = tile_j + GRAVITY_TILE < n ? tile_j + GRAVITY_TILE : n;
+      for (size_t i = tile_i; i < end_i; i++) {
+        gravity_direct_row(group, i, tile_j == tile_i ? i + 1 : tile_j, end_j);
+      }
+    }
+  }
+}
+
+void GravityGroupForceCreator(void *aux) {
+  GravityGroup *group = (GravityGroup*)aux;
+  size_t n = group->bodies.size;
+  if (n < 2) {
+    return;
+  }
+  double_array_reserve(&group->xs, n);
+  double_array_reserve(&group->ys, n);
+  double_array_reserve(&group->masses, n);
+  double_array_reserve(&group->force_xs, n);
+  double_array_reserve(&group->force_ys, n);
+  group->xs.size = group->ys.size = group->masses.size = n;
+  group->force_xs.size = group->force_ys.size = n;
+  for (size_t i = 0; i < n; i++) {
+    Body *body = group->bodies.data[i];
+    Vector position = body_get_centroid(body);
+    group->xs.data[i] = position.x;
+    group->ys.data[i] = position.y;
+    group->masses.data[i] = body_get_mass(body);
+    group->force_xs.data[i] = 0;
+    group->force_ys.data[i] = 0;
+  }
+
+  if (n <= group->direct_max) {
+    gravity_direct_forces(group);
+  }
+  else {
+    gravity_tree_build(group);
+    for (size_t i = 0; i < n; i++) {
+      Vector force = gravity_tree_force(group, i);
+      group->force_xs.data[i] = force.x;
+      group->force_ys.data[i] = force.y;
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    Vector force = {group->force_xs.data[i], group->force_ys.data[i]};
+    body_add_force(group->bodies.data[i], force);
+  }
+}
+
+void create_uniform_gravity(Scene *scene, const GravityField *field, Body *body) {
+  UniformGravityParams *aux = scene_add_batched_force_creator(
+    scene, UniformGravityBatchForceCreator, sizeof(UniformGravityParams), &body, 1, NULL
+  );
+  aux->field = field;
+  aux->body = body;
+  // Never equal to the field, so the force is applied even if the body is asleep
+  aux->applied = (Vector){NAN, NAN};
+  scene_set_batch_wake_check(scene, UniformGravityBatchForceCreator, UniformGravityChanged);
+}
+
+bool UniformGravityChanged(void *aux) {
+  UniformGravityParams *g = (UniformGravityParams*)aux;
+  return g->field->acceleration.x != g->applied.x || g->field->acceleration.y != g->applied.y;
+}
+
+void UniformGravityForceCreator(void *aux) {
+  UniformGravityParams *g = (UniformGravityParams*)aux;
+  g->applied = g->field->acceleration;
+  double mass = body_get_mass(g->body);
+  // F = mg, which is undefined for infinite masses (and for them, a = 0)
+  if (mass != INFINITY) {
+    body_add_force(g->body, vec_multiply(mass, g->field->acceleration));
+  }
+}
+
+void UniformGravityBatchForceCreator(void *params, size_t count) {
+  UniformGravityParams *gravities = (UniformGravityParams*)params;
+  for (size_t i = 0; i < count; i++) {
+    UniformGravityForceCreator(&gravities[i]);
+  }
+}
+
 void create_spring(Scene *scene, double k, Body *body1, Body *body2) {
-  SpringParams *aux = malloc(sizeof(SpringParams));
+  Body *bodies[] = {body1, body2};
+  SpringParams *aux = scene_add_batched_force_creator(
+    scene, SpringBatchForceCreator, sizeof(SpringParams), bodies, 2, NULL
+  );
   aux->k = k;
   aux->body1 = body1;
   aux->anchor = body2;
-  List *bodies = list_init(2, free);
-  list_add(bodies, (void*)body1);
-  list_add(bodies, (void*)body2);
-  scene_add_bodies_force_creator(scene, (ForceCreator)SpringForceCreator, (void*)aux, bodies, (FreeFunc)free);
 }
 
 void SpringForceCreator(void *aux) {
@@ -118,45 +560,48 @@ void SpringForceCreator(void *aux) {
   double k = s->k;
   Body *body1 = s->body1;
   Body *anchor = s->anchor;
-  double dist = body_distance(body1, anchor);
-  double force_magnitude = k * dist;
+  // k * distance along the unit direction is just k times the displacement,
+  // which stays finite when the two bodies are at the same point
   Vector anch_loc = body_get_centroid(anchor);
   Vector body1_loc = body_get_centroid(body1);
-  Vector direction = unit_vector(vec_subtract(anch_loc, body1_loc));
-  Vector force_on_1 = vec_multiply(force_magnitude, direction);
+  Vector force_on_1 = vec_multiply(k, vec_subtract(anch_loc, body1_loc));
   Vector force_on_anch = vec_negate(force_on_1);
   body_add_force(body1, force_on_1);
   body_add_force(anchor, force_on_anch);
 }
 
+void SpringBatchForceCreator(void *params, size_t count) {
+  SpringParams *springs = (SpringParams*)params;
+  for (size_t i = 0; i < count; i++) {
+    SpringForceCreator(&springs[i]);
+  }
+}
+
 void create_drag(Scene *scene, double gamma, Body *body) {
-  DragParams *aux = malloc(sizeof(DragParams));
-  aux->gamma = gamma;
-  aux->body = body;
-  List *bodies = list_init(1, free);
-  list_add(bodies, (void*)body);
-  scene_add_bodies_force_creator(scene, (ForceCreator)DragForceCreator, (void*)aux, bodies, (FreeFunc)free);
+  body_set_damping(
+    body, body_get_linear_damping(body) + gamma, body_get_quadratic_damping(body)
+  );
 }
 
-void DragForceCreator(void *aux) {
-  DragParams *d = (DragParams*)aux;
-  double gamma = d->gamma;
-  Body *body = d->body;
-  Vector force = vec_multiply(-1 * gamma, body_get_velocity(body));
-  body_add_force(body, force);
+void gen_coll_params_cleanup(GenCollParams *params) {
+  if (params->aux_freer != NULL) {
+    params->aux_freer(params->aux);
+  }
 }
 
 void create_collision(Scene *scene, Body *body1, Body *body2,
   CollisionHandler handler, void *aux, FreeFunc freer) {
-    GenCollParams *auxc = malloc(sizeof(GenCollParams));
+    Body *bodies[] = {body1, body2};
+    GenCollParams *auxc = scene_add_batched_force_creator(
+      scene, CollisionBatchCreator, sizeof(GenCollParams), bodies, 2,
+      (FreeFunc)gen_coll_params_cleanup
+    );
     auxc->body1 = body1;
     auxc->body2 = body2;
     auxc->aux = aux;
+    auxc->aux_freer = freer;
     auxc->ch = handler;
-    List *bodies = list_init(2, free);
-    list_add(bodies, body1);
-    list_add(bodies, body2);
-    scene_add_bodies_force_creator(scene, (ForceCreator)CollisionCreator, (void*)auxc, bodies, free);
+    auxc->col_slt = false;
 }
 
 void CollisionCreator(void *aux) {
@@ -165,78 +610,175 @@ void CollisionCreator(void *aux) {
   Body *body2 = ch->body2;
   bool col_slt = ch->col_slt;
   CollisionHandler col_handler = ch->ch;
-  CollisionInfo ci = find_collision(body_get_shape(body1), body_get_shape(body2));
+  CollisionInfo ci = find_body_collision(body1, body2);
   if (ci.collided && !col_slt) {
-    col_handler(body1, body2, ci.axis, ch->aux);
     ch->col_slt = true;
+    col_handler(body1, body2, ci.axis, ch->aux);
   }
   else if (!ci.collided) {
     ch->col_slt = false;
   }
 }
 
+void CollisionBatchCreator(void *params, size_t count) {
+  GenCollParams *collisions = (GenCollParams*)params;
+  for (size_t i = 0; i < count; i++) {
+    CollisionCreator(&collisions[i]);
+  }
+}
+
 void create_destructive_collision(Scene *scene, Body *body1, Body *body2) {
-  CollParams *aux = malloc(sizeof(CollParams));
+  Body *bodies[] = {body1, body2};
+  CollParams *aux = scene_add_batched_force_creator(
+    scene, DestructiveCollisionBatchCreator, sizeof(CollParams), bodies, 2, NULL
+  );
   aux->body1 = body1;
   aux->body2 = body2;
-  List *bodies = list_init(2, free);
-  list_add(bodies, body1);
-  list_add(bodies, body2);
-  scene_add_bodies_force_creator(scene, (ForceCreator)DestructiveCollisionCreator, (void*)aux, bodies, free);
 }
 
 void DestructiveCollisionCreator(void *aux) {
   CollParams *c = (CollParams*)aux;
   Body *body1 = c->body1;
   Body *body2 = c->body2;
-  if(find_collision(body_get_shape(body1), body_get_shape(body2)).collided) {
+  if(find_body_collision(body1, body2).collided) {
     body_remove(body1);
     body_remove(body2);
   }
 }
 
+void DestructiveCollisionBatchCreator(void *params, size_t count) {
+  CollParams *collisions = (CollParams*)params;
+  for (size_t i = 0; i < count; i++) {
+    DestructiveCollisionCreator(&collisions[i]);
+  }
+}
+
+// Bodies that ignore impulses act like they have infinite mass in collisions
+double collision_mass(Body *body) {
+  if (body_get_type(body) != BODY_DYNAMIC) {
+    return INFINITY;
+  }
+  return body_get_mass(body);
+}
+
+double inverse_mass(Body *body) {
+  return 1 / collision_mass(body);
+}
+
 void create_physics_collision(Scene *scene, double elasticity, Body *body1, Body *body2) {
-  PhysCollParams *aux = malloc(sizeof(PhysCollParams));
+  Body *bodies[] = {body1, body2};
+  PhysCollParams *aux = scene_add_iterative_constraint(
+    scene, (ForceCreator)PhysicsCollisionPrepare, (ForceCreator)PhysicsCollisionSolve,
+    sizeof(PhysCollParams), bodies, 2, NULL
+  );
   aux->body1 = body1;
   aux->body2 = body2;
   aux->e = elasticity;
-  aux->col_slt = false;
-  List *bodies = list_init(2, free);
-  list_add(bodies, body1);
-  list_add(bodies, body2);
-  scene_add_bodies_force_creator(scene, (ForceCreator)PhysicsCollisionCreator, (void*)aux, bodies, free);
+  aux->touching = false;
+  aux->normal = VEC_ZERO;
+  aux->accumulated = 0;
 }
 
-void PhysicsCollisionCreator(void *aux) {
-  PhysCollParams *ch = (PhysCollParams*)aux;
-  Body *body1 = ch->body1;
-  Body *body2 = ch->body2;
-  double e = ch->e;
-  bool col_slt = ch->col_slt;
-  CollisionInfo ci = find_collision(body_get_shape(body1), body_get_shape(body2));
-  if (ci.collided && !col_slt) {
-    double mass1 = body_get_mass(body1);
-    double mass2 = body_get_mass(body2);
-    double speed1 = vec_dot(body_get_velocity(body1), ci.axis);
-    double speed2 = vec_dot(body_get_velocity(body2), ci.axis);
-    double reduced_mass = (mass1 * mass2) / (mass1 + mass2);
-    double impulse_mag;
-    if (mass1 == INFINITY) {
-      impulse_mag = mass2 * (1 + e) * (speed2 - speed1);
-    }
-    else if (mass2 == INFINITY) {
-      impulse_mag = mass1 * (1 + e) * (speed2 - speed1);
-    }
-    else {
-      impulse_mag = reduced_mass * (1 + e) * (speed2 - speed1);
-    }
-    Vector impulse1 = vec_multiply(impulse_mag, ci.axis);
-    Vector impulse2 = vec_negate(impulse1);
-    body_add_impulse(body1, impulse1);
-    body_add_impulse(body2, impulse2);
-    ch->col_slt = true;
+// Applies an impulse pushing body1 and body2 apart along the normal
+void apply_contact_impulse(PhysCollParams *c, double impulse) {
+  Vector p = vec_multiply(impulse, c->normal);
+  double inv1 = inverse_mass(c->body1);
+  double inv2 = inverse_mass(c->body2);
+  if (inv1 != 0) {
+    body_set_velocity(c->body1, vec_subtract(body_get_velocity(c->body1), vec_multiply(inv1, p)));
   }
-  else if (!ci.collided) {
-    ch->col_slt = false;
+  if (inv2 != 0) {
+    body_set_velocity(c->body2, vec_add(body_get_velocity(c->body2), vec_multiply(inv2, p)));
+  }
+}
+
+void PhysicsCollisionPrepare(void *aux) {
+  PhysCollParams *c = (PhysCollParams*)aux;
+  double inv1 = inverse_mass(c->body1);
+  double inv2 = inverse_mass(c->body2);
+  CollisionInfo ci = find_body_collision(c->body1, c->body2);
+  if (!ci.collided || inv1 + inv2 == 0) {
+    c->touching = false;
+    c->accumulated = 0;
+    return;
+  }
+
+  // Last tick's impulse is only a good guess if the contact has not turned
+  if (!c->touching || vec_dot(ci.axis, c->normal) < CONTACT_WARM_START_ALIGNMENT) {
+    c->accumulated = 0;
+  }
+  c->touching = true;
+  c->normal = ci.axis;
+  c->normal_mass = 1 / (inv1 + inv2);
+
+  // Bounce back at e times the approach speed
+  Vector relative_velocity = vec_subtract(body_get_velocity(c->body2), body_get_velocity(c->body1));
+  double normal_speed = vec_dot(relative_velocity, c->normal);
+  c->target_speed = normal_speed < 0 ? -c->e * normal_speed : 0;
+
+  // Move the bodies most of the way apart, in proportion to their inverse masses.
+  // The rest of the overlap keeps the contact alive until the next tick.
+  double correction = CONTACT_CORRECTION * ci.overlap / (inv1 + inv2);
+  if (inv1 != 0) {
+    Vector centroid = body_get_centroid(c->body1);
+    body_set_centroid(c->body1, vec_subtract(centroid, vec_multiply(correction * inv1, c->normal)));
+  }
+  if (inv2 != 0) {
+    Vector centroid = body_get_centroid(c->body2);
+    body_set_centroid(c->body2, vec_add(centroid, vec_multiply(correction * inv2, c->normal)));
+  }
+
+  apply_contact_impulse(c, c->accumulated);
+}
+
+void PhysicsCollisionSolve(void *aux) {
+  PhysCollParams *c = (PhysCollParams*)aux;
+  if (!c->touching) {
+    return;
+  }
+  Vector relative_velocity = vec_subtract(body_get_velocity(c->body2), body_get_velocity(c->body1));
+  double normal_speed = vec_dot(relative_velocity, c->normal);
+  double impulse = c->normal_mass * (c->target_speed - normal_speed);
+
+  // The total impulse can only ever push the bodies apart
+  double accumulated = fmax(c->accumulated + impulse, 0);
+  impulse = accumulated - c->accumulated;
+  c->accumulated = accumulated;
+  apply_contact_impulse(c, impulse);
+}
+
+void create_half_plane(
+  Scene *scene, Vector point, Vector normal, double elasticity, Body *body
+) {
+  HalfPlaneParams *aux = scene_add_constraint(
+    scene, (ForceCreator)HalfPlaneConstraint, sizeof(HalfPlaneParams), &body, 1, NULL
+  );
+  aux->point = point;
+  aux->normal = unit_vector(normal);
+  aux->e = elasticity;
+  aux->body = body;
+}
+
+void HalfPlaneConstraint(void *aux) {
+  HalfPlaneParams *h = (HalfPlaneParams*)aux;
+  const VectorArray *vertices = body_get_vertices(h->body);
+
+  // How far the deepest vertex is past the line (negative if it is past)
+  double depth = INFINITY;
+  for (size_t i = 0; i < vertices->size; i++) {
+    depth = fmin(depth, vec_dot(vec_subtract(vertices->data[i], h->point), h->normal));
+  }
+  if (depth >= 0) {
+    return;
+  }
+
+  Vector centroid = body_get_centroid(h->body);
+  body_set_centroid(h->body, vec_subtract(centroid, vec_multiply(depth, h->normal)));
+
+  Vector velocity = body_get_velocity(h->body);
+  double normal_speed = vec_dot(velocity, h->normal);
+  if (normal_speed < 0) {
+    Vector correction = vec_multiply(-(1 + h->e) * normal_speed, h->normal);
+    body_set_velocity(h->body, vec_add(velocity, correction));
   }
 }
@@ -1,4 +1,5 @@
 #include "list.h"
+#include "alloc_tracker.h"
 #include <stdlib.h>
 #include <assert.h>
 
@@ -7,13 +8,13 @@
 struct list {
   void** elements;
   size_t size;
-  int capacity;
+  size_t capacity;
   FreeFunc freer;
 };
 
 List *list_init(size_t initial_size, FreeFunc freer) {
-  List *list = malloc(sizeof(List));
-  list->elements = malloc(initial_size * sizeof(void*));
+  List *list = TRACKED_MALLOC(sizeof(List));
+  list->elements = TRACKED_MALLOC(initial_size * sizeof(void*));
   list->size = 0;
   list->capacity = initial_size;
   list->freer = freer;
@@ -28,8 +29,8 @@ void list_free(List *list) {
     }
   }
 
-  free(list->elements);
-  free(list);
+  TRACKED_FREE(list->elements);
+  TRACKED_FREE(list);
 }
 
 size_t list_size(List *list) {
@@ -49,21 +50,11 @@ void list_set(List *list, size_t index, void *value) {
 }
 
 void list_resize(List *list) {
-  size_t init_capacity = list->capacity;
-  void** bigger;
-  if (list->capacity == 0) {
-    bigger = malloc(sizeof(void*));
-    list->capacity = 1;
-  }
-  else {
-    bigger = malloc(GROWTH_FACTOR * list->capacity * sizeof(void*));
-    list->capacity *= 2;
-  }
-  for (size_t i = 0; i < init_capacity; i++) {
-    bigger[i] = list->elements[i];
-  }
-  free(list->elements);
+  size_t capacity = list->capacity == 0 ? 1 : GROWTH_FACTOR * list->capacity;
+  void **bigger = TRACKED_REALLOC(list->elements, capacity * sizeof(void*));
+  assert(bigger);
   list->elements = bigger;
+  list->capacity = capacity;
 }
 
 void list_add(List *list, void *value) {
@@ -100,3 +91,42 @@ void *list_remove(List *list, size_t index) {
 
   return element;
 }
+
+size_t list_remove_if(List *list, ListPredicate should_remove, bool stable) {
+  size_t old_size = list->size;
+
+  if (stable) {
+    size_t kept = 0;
+    for (size_t i = 0; i < list->size; i++) {
+      void *element = list->elements[i];
+      if (should_remove(element)) {
+        if (list->freer != NULL) {
+          list->freer(element);
+        }
+      }
+      else {
+        list->elements[kept] = element;
+        kept++;
+      }
+    }
+    list->size = kept;
+  }
+  else {
+    size_t i = 0;
+    while (i < list->size) {
+      void *element = list->elements[i];
+      if (should_remove(element)) {
+        if (list->freer != NULL) {
+          list->freer(element);
+        }
+        list->size--;
+        list->elements[i] = list->elements[list->size];
+      }
+      else {
+        i++;
+      }
+    }
+  }
+
+  return old_size - list->size;
+}
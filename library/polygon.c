@@ -36,56 +36,111 @@ double polygon_area(List *polygon) {
 }
 
 Vector polygon_centroid(List *polygon) {
+  double cross_sum = 0.0;
   double xSum = 0.0;
   double ySum = 0.0;
 
-  size_t i;
-  for (i = 0; i < list_size(polygon) - 1; i++) {
+  // The area is accumulated in the same pass, rather than by polygon_area()
+  size_t n = list_size(polygon);
+  for (size_t i = 0; i < n; i++) {
     Vector *curr = (Vector*)list_get(polygon, i);
-    Vector *next = (Vector*)list_get(polygon, i+1);
+    Vector *next = (Vector*)list_get(polygon, (i + 1) % n);
+    double cross = vec_cross(*curr, *next);
 
-    xSum += (curr->x + next->x) * vec_cross(*curr, *next);
-    ySum += (curr->y + next->y) * vec_cross(*curr, *next);
+    cross_sum += cross;
+    xSum += (curr->x + next->x) * cross;
+    ySum += (curr->y + next->y) * cross;
   }
 
-  // Edge from the 1st vertex to the last vertex
-  Vector *first = (Vector*)list_get(polygon, 0);
-  Vector *last = (Vector*)list_get(polygon, list_size(polygon) - 1);
+  double area = cross_sum / 2;
+  return (Vector){.x = 1/(6*area) * xSum, .y = 1/(6*area) * ySum};
+}
 
-  xSum += (last->x + first->x) * vec_cross(*last, *first);
-  ySum += (last->y + first->y) * vec_cross(*last, *first);
+PolygonMetrics polygon_metrics(const Vector *vertices, size_t count) {
+  PolygonMetrics metrics = {
+    .area = 0.0, .centroid = VEC_ZERO, .min = VEC_ZERO, .max = VEC_ZERO
+  };
+  if (count == 0) {
+    return metrics;
+  }
 
-  double area = polygon_area(polygon);
-  Vector*center = malloc(sizeof(Vector));
-  center->x = 1/(6*area) * xSum;
-  center->y = 1/(6*area) * ySum;
+  double cross_sum = 0.0;
+  double xSum = 0.0;
+  double ySum = 0.0;
+  Vector min = vertices[0];
+  Vector max = vertices[0];
+
+  for (size_t i = 0; i < count; i++) {
+    Vector curr = vertices[i];
+    Vector next = vertices[i + 1 < count ? i + 1 : 0];
+    double cross = vec_cross(curr, next);
+
+    cross_sum += cross;
+    xSum += (curr.x + next.x) * cross;
+    ySum += (curr.y + next.y) * cross;
+
+    min.x = fmin(min.x, curr.x);
+    min.y = fmin(min.y, curr.y);
+    max.x = fmax(max.x, curr.x);
+    max.y = fmax(max.y, curr.y);
+  }
 
-  return *center;
+  metrics.area = cross_sum / 2;
+  metrics.min = min;
+  metrics.max = max;
+  // Degenerate polygons have no area, so fall back to the vertex average
+  if (metrics.area != 0) {
+    metrics.centroid = (Vector){
+      .x = xSum / (6 * metrics.area), .y = ySum / (6 * metrics.area)
+    };
+  }
+  else {
+    double sum_x = 0.0, sum_y = 0.0;
+    for (size_t i = 0; i < count; i++) {
+      sum_x += vertices[i].x;
+      sum_y += vertices[i].y;
+    }
+    metrics.centroid = (Vector){.x = sum_x / count, .y = sum_y / count};
+  }
+  return metrics;
+}
+
+void polygon_edge_normals(const Vector *vertices, size_t count, double orientation, Vector *normals) {
+  for (size_t i = 0; i < count; i++) {
+    Vector edge = vec_subtract(vertices[i + 1 < count ? i + 1 : 0], vertices[i]);
+    double length = sqrt(vec_dot(edge, edge));
+    normals[i] = VEC_ZERO;
+    if (length > 0) {
+      normals[i] = vec_multiply(orientation / length, (Vector){.x = edge.y, .y = -edge.x});
+    }
+  }
 }
 
 void polygon_translate(List *polygon, Vector translation) {
   size_t i;
   for (i = 0; i < list_size(polygon); i++) {
-    Vector newVec = vec_add(*((Vector*)list_get(polygon, i)), translation);
-    Vector *newVecPointer = malloc(sizeof(Vector));
-    newVecPointer->x = newVec.x;
-    newVecPointer->y = newVec.y;
-    list_set(polygon, i, (void*)newVecPointer);
+    Vector *vertex = (Vector*)list_get(polygon, i);
+    *vertex = vec_add(*vertex, translation);
   }
 }
 
 void polygon_rotate(List *polygon, double angle, Vector point) {
-  polygon_translate(polygon, vec_negate(point));
-
-  // Rotate the points around the origin
   size_t i;
   for (i = 0; i < list_size(polygon); i++) {
-    Vector newVec = vec_rotate(*((Vector*)list_get(polygon, i)), angle);
-    Vector*newPoint = malloc(sizeof(Vector));
-    newPoint->x = newVec.x;
-    newPoint->y = newVec.y;
-    list_set(polygon, i, (void*)newPoint);
+    Vector *vertex = (Vector*)list_get(polygon, i);
+    *vertex = vec_add(vec_rotate(vec_subtract(*vertex, point), angle), point);
   }
+}
 
-  polygon_translate(polygon, point);
-}
\ No newline at end of file
+void polygon_translate_array(VectorArray *polygon, Vector translation) {
+  for (size_t i = 0; i < polygon->size; i++) {
+    polygon->data[i] = vec_add(polygon->data[i], translation);
+  }
+}
+
+void polygon_rotate_array(VectorArray *polygon, double angle, Vector point) {
+  for (size_t i = 0; i < polygon->size; i++) {
+    Vector from_point = vec_subtract(polygon->data[i], point);
+    polygon->data[i] = vec_add(vec_rotate(from_point, angle), point);
+  }
+}
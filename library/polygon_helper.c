@@ -1,9 +1,11 @@
+#define ALLOC_TAG ALLOC_SHAPE
 #include "polygon_helper.h"
+#include "alloc_tracker.h"
 #include <stdlib.h>
 #include <math.h>
 
 List *polygon_points(Vector center, int vertices, int radius, double star_factor) {
-    List *points = list_init(vertices * 2, free);
+    List *points = list_init(vertices * 2, TRACKED_FREE);
 
     double angle = M_PI / 2 * -1;
     int i = 0;
@@ -15,7 +17,7 @@ List *polygon_points(Vector center, int vertices, int radius, double star_factor
         r /= star_factor;
       }
 
-      Vector* point = malloc(sizeof(Vector));
+      Vector* point = TRACKED_MALLOC(sizeof(Vector));
       point->x = r * cos(angle) + center.x;
       point->y = r * sin(angle) + center.y;
 
@@ -26,17 +28,17 @@ List *polygon_points(Vector center, int vertices, int radius, double star_factor
 }
 
 List *ellipse_points(Vector center, int vertices, int x_radius, int y_radius) {
-    List *points = list_init(vertices, free);
+    List *points = list_init(vertices, TRACKED_FREE);
     for (int i = vertices / 2; i >= -vertices / 2; i--) {
       Vector new = {.x = i, .y = y_radius * sqrt(1 - pow((double)i / (double)x_radius, 2))};
-      Vector* new_point = malloc(sizeof(Vector));
+      Vector* new_point = TRACKED_MALLOC(sizeof(Vector));
       new_point->x = new.x;
       new_point->y = new.y;
       list_add(points, (void*)new_point);
     }
     for (int i = -vertices / 2; i <= vertices / 2; i++) {
       Vector new = {.x = i, .y = -(y_radius) * sqrt(1 - pow((double)i / (double)x_radius, 2))};
-      Vector* new_point = malloc(sizeof(Vector));
+      Vector* new_point = TRACKED_MALLOC(sizeof(Vector));
       new_point->x = new.x;
       new_point->y = new.y;
       list_add(points, (void*)new_point);
@@ -46,12 +48,12 @@ List *ellipse_points(Vector center, int vertices, int x_radius, int y_radius) {
 }
 
 List* pie(Vector center, int vertices, int radius, double angle_start, double angle_end) {
-    List *points = list_init(vertices * 2, free);
+    List *points = list_init(vertices * 2, TRACKED_FREE);
     double angle = angle_start;
     for (int i = 0; i < vertices; i++) {
       angle += (angle_end - angle_start) / vertices;
 
-      Vector* point = malloc(sizeof(Vector));
+      Vector* point = TRACKED_MALLOC(sizeof(Vector));
       point->x = radius * cos(angle) + center.x;
       point->y = radius * sin(angle) + center.y;
 
@@ -62,21 +64,21 @@ List* pie(Vector center, int vertices, int radius, double angle_start, double an
 }
 
 List *rectangle_points(Vector center, double width, double height) {
-  List *points = list_init(4, free);
+  List *points = list_init(4, TRACKED_FREE);
 
-  Vector *top_left = malloc(sizeof(Vector));
+  Vector *top_left = TRACKED_MALLOC(sizeof(Vector));
   top_left->x = center.x - width / 2;
   top_left->y = center.y + height / 2;
 
-  Vector *bottom_left = malloc(sizeof(Vector));
+  Vector *bottom_left = TRACKED_MALLOC(sizeof(Vector));
   bottom_left->x = center.x - width / 2;
   bottom_left->y = center.y - height / 2;
 
-  Vector *top_right = malloc(sizeof(Vector));
+  Vector *top_right = TRACKED_MALLOC(sizeof(Vector));
   top_right->x = center.x + width / 2;
   top_right->y = center.y + height / 2;
 
-  Vector *bottom_right = malloc(sizeof(Vector));
+  Vector *bottom_right = TRACKED_MALLOC(sizeof(Vector));
   bottom_right->x = center.x + width / 2;
   bottom_right->y = center.y - height / 2;
 
@@ -1,124 +1,1161 @@
+#define ALLOC_TAG ALLOC_SCENE
 #include "scene.h"
-#include "sdl_wrapper.h"
+#include "alloc_tracker.h"
+#include "collision.h"
+#include <stddef.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
 
 #define INITIAL_BODIES 20
+#define INITIAL_FORCERS 4
+#define DEFAULT_SOLVER_ITERATIONS 8
 
-struct scene {
+struct forcer {
+  ForceCreator forcer;
+  // Only used by constraints: called once per tick before the iterations
+  ForceCreator prepare;
+  // Only used by group force creators: called before removed bodies are freed
+  ForceCreator prune;
+  // Only used by group force creators: the bodies they act on, if given,
+  // which sleep and wake together. Entries may be NULL.
+  const BodyArray *group_bodies;
+  void* aux;
+  FreeFunc freer;
+  // Whether aux points at inline_aux (which moves with the forcer)
+  bool aux_is_inline;
+  // Whether aux was allocated by the scene and should be freed with the forcer
+  bool aux_is_owned;
   size_t num_bodies;
-  List* bodies;
-  List* forcers;
+  // Forcers with few bodies store them inline; others allocate heap_bodies
+  Body *inline_bodies[FORCER_INLINE_BODIES];
+  Body **heap_bodies;
+  union {
+    max_align_t align;
+    unsigned char bytes[FORCER_INLINE_AUX_SIZE];
+  } inline_aux;
 };
 
-struct forcer {
-  void* aux;
-  ForceCreator forcer;
-  List* bodies;
+DEFINE_ARRAY(ForcerArray, forcer_array, Forcer)
+
+typedef struct {
+  Body *bodies[FORCER_INLINE_BODIES];
+  size_t num_bodies;
+} BatchEntry;
+
+DEFINE_ARRAY(BatchEntryArray, batch_entry_array, BatchEntry)
+
+// A force creator added to a batch while the batch was running,
+// which has to wait to be moved into the batch's parameters
+typedef struct {
+  void *params;
+  BatchEntry entry;
+} PendingEntry;
+
+DEFINE_ARRAY(PendingEntryArray, pending_entry_array, PendingEntry)
+
+typedef struct {
+  BatchForceCreator run;
+  size_t params_size;
+  FreeFunc cleanup;
+  BatchWakeCheck wake_check;
+  // The parameters of every force creator in the batch, stored contiguously,
+  // with room for as many as entries has capacity for
+  unsigned char *params;
+  // The bodies of each force creator, in the same order
+  BatchEntryArray entries;
+  bool running;
+  PendingEntryArray pending;
+} ForceBatch;
+
+DEFINE_ARRAY(ForceBatchArray, force_batch_array, ForceBatch)
+DEFINE_ARRAY(IndexArray, index_array, size_t)
+DEFINE_ARRAY(DoubleArray, double_array, double)
+
+// The last samples of one statistic, in a ring buffer as long as the window
+typedef struct {
+  DoubleArray samples;
+  size_t recorded;
+} SampleRing;
+
+struct scene {
+  // Every body, in the order they were added
+  BodyArray bodies;
+  // The same bodies, partitioned by how scene_tick() moves them
+  BodyArray dynamic_bodies;
+  BodyArray kinematic_bodies;
+  // Static bodies are never ticked, so their cached vertices stay valid
+  BodyArray static_bodies;
+  ForcerArray forcers;
+  // Force creators of the same kind, run together before the other forcers
+  ForceBatchArray batches;
+  // Run after the bodies are ticked, to correct their positions and velocities
+  ForcerArray constraints;
+  size_t solver_iterations;
+  Integrator integrator;
+  // Whether bodies' damping is applied as exact decay instead of as a force
+  bool exact_damping;
+  // Scratch space for RK4: the bodies being integrated, and their states
+  BodyArray rk4_bodies;
+  VectorArray rk4_states;
+  bool stable_removal;
+  bool running_forcers;
+  // The dt of the tick in progress
+  double tick_dt;
+  // Sleeping is disabled unless both of these are positive
+  double sleep_speed;
+  double sleep_time;
+  // Scratch space for grouping dynamic bodies into islands, indexed by the
+  // bodies' positions in dynamic_bodies
+  IndexArray island_parents;
+  DoubleArray island_rest_times;
+  // Adaptive substepping is disabled unless substep_motion is positive
+  double substep_motion;
+  size_t max_substeps;
+  // Scratch space for the forces and impulses of the bodies sharing a force
+  // creator with a substepped body
+  VectorArray substep_saved;
+  // Scratch space for the interpolated vertices of the body being rendered
+  VectorArray render_vertices;
+  // Statistics are disabled unless stats_window is positive
+  size_t stats_window;
+  SampleRing stage_samples[SCENE_STAGE_COUNT];
+  SampleRing forcers_run_samples;
+  SampleRing sat_test_samples;
+  SampleRing bodies_removed_samples;
+  // The current tick's stage times and counts, recorded when it ends
+  double stage_times[SCENE_STAGE_COUNT];
+  size_t forcers_run;
+  size_t sat_tests_before;
+  size_t bodies_removed;
+  // Scratch space for sorting samples into percentiles
+  DoubleArray sorted_samples;
 };
 
+Body **forcer_bodies(Forcer *forcer) {
+  return forcer->heap_bodies != NULL ? forcer->heap_bodies : forcer->inline_bodies;
+}
+
+void *forcer_aux(Forcer *forcer) {
+  return forcer->aux_is_inline ? (void*)forcer->inline_aux.bytes : forcer->aux;
+}
+
+void forcer_free(Forcer *forcer) {
+  void *aux = forcer_aux(forcer);
+  if (forcer->freer != NULL) {
+    forcer->freer(aux);
+  }
+  if (forcer->aux_is_owned) {
+    TRACKED_FREE(aux);
+  }
+  TRACKED_FREE(forcer->heap_bodies);
+}
+
+void *force_batch_params(ForceBatch *batch, size_t index) {
+  return batch->params + index * batch->params_size;
+}
+
+void force_batch_free(ForceBatch *batch) {
+  for (size_t i = 0; i < batch->entries.size; i++) {
+    if (batch->cleanup != NULL) {
+      batch->cleanup(force_batch_params(batch, i));
+    }
+  }
+  TRACKED_FREE(batch->params);
+  batch_entry_array_free(&batch->entries);
+  pending_entry_array_free(&batch->pending);
+}
+
+void *force_batch_add(ForceBatch *batch, BatchEntry entry) {
+  // Growing the parameters would move them out from under the running batch
+  if (batch->running) {
+    PendingEntry pending = {.params = TRACKED_MALLOC(batch->params_size), .entry = entry};
+    assert(pending.params);
+    pending_entry_array_add(&batch->pending, pending);
+    return pending.params;
+  }
+  size_t old_capacity = batch->entries.capacity;
+  batch_entry_array_add(&batch->entries, entry);
+  if (batch->entries.capacity != old_capacity) {
+    unsigned char *params = TRACKED_REALLOC(batch->params, batch->entries.capacity * batch->params_size);
+    assert(params);
+    batch->params = params;
+  }
+  return force_batch_params(batch, batch->entries.size - 1);
+}
+
+// Moves the force creators added while the batch was running into it
+void force_batch_finish_running(ForceBatch *batch) {
+  batch->running = false;
+  for (size_t i = 0; i < batch->pending.size; i++) {
+    PendingEntry *pending = &batch->pending.data[i];
+    memcpy(force_batch_add(batch, pending->entry), pending->params, batch->params_size);
+    TRACKED_FREE(pending->params);
+  }
+  pending_entry_array_clear(&batch->pending);
+}
+
+void sample_ring_init(SampleRing *ring) {
+  double_array_init(&ring->samples, 0);
+  ring->recorded = 0;
+}
+
+void sample_ring_add(SampleRing *ring, size_t window, double sample) {
+  if (ring->samples.size < window) {
+    double_array_add(&ring->samples, sample);
+  }
+  else {
+    ring->samples.data[ring->recorded % window] = sample;
+  }
+  ring->recorded++;
+}
+
+void scene_reset_tick_stats(Scene *scene) {
+  for (size_t i = 0; i < SCENE_STAGE_COUNT; i++) {
+    scene->stage_times[i] = 0;
+  }
+  scene->forcers_run = 0;
+  scene->sat_tests_before = collision_test_count();
+  scene->bodies_removed = 0;
+}
+
+// Returns the current time in seconds, or 0 if statistics are disabled
+double scene_stats_clock(Scene *scene) {
+  if (scene->stats_window == 0) {
+    return 0;
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Adds the time since start to a stage of the current tick,
+// and returns the current time so the next stage can start from it
+double scene_end_stage(Scene *scene, SceneStage stage, double start) {
+  double now = scene_stats_clock(scene);
+  scene->stage_times[stage] += now - start;
+  return now;
+}
+
+void scene_record_tick(Scene *scene) {
+  size_t window = scene->stats_window;
+  for (size_t i = 0; i < SCENE_STAGE_COUNT; i++) {
+    if (i != SCENE_STAGE_RENDER) {
+      sample_ring_add(&scene->stage_samples[i], window, scene->stage_times[i]);
+    }
+  }
+  sample_ring_add(&scene->forcers_run_samples, window, scene->forcers_run);
+  sample_ring_add(
+    &scene->sat_test_samples, window, collision_test_count() - scene->sat_tests_before
+  );
+  sample_ring_add(&scene->bodies_removed_samples, window, scene->bodies_removed);
+}
+
+int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+double nearest_rank(const DoubleArray *sorted, double percentile) {
+  size_t rank = (size_t)ceil(percentile * sorted->size);
+  return sorted->data[rank > 0 ? rank - 1 : 0];
+}
+
+SceneSampleStats sample_ring_stats(Scene *scene, SampleRing *ring) {
+  SceneSampleStats stats = {0};
+  size_t count = ring->samples.size;
+  if (count == 0) {
+    return stats;
+  }
+  stats.last = ring->samples.data[(ring->recorded - 1) % count];
+
+  DoubleArray *sorted = &scene->sorted_samples;
+  double_array_clear(sorted);
+  double_array_append(sorted, ring->samples.data, count);
+  qsort(sorted->data, count, sizeof(double), compare_doubles);
+  double sum = 0;
+  for (size_t i = 0; i < count; i++) {
+    sum += sorted->data[i];
+  }
+  stats.average = sum / count;
+  stats.median = nearest_rank(sorted, 0.5);
+  stats.p95 = nearest_rank(sorted, 0.95);
+  stats.p99 = nearest_rank(sorted, 0.99);
+  stats.max = sorted->data[count - 1];
+  return stats;
+}
+
+void scene_set_stats_window(Scene *scene, size_t ticks) {
+  scene->stats_window = ticks;
+  for (size_t i = 0; i < SCENE_STAGE_COUNT; i++) {
+    double_array_clear(&scene->stage_samples[i].samples);
+    scene->stage_samples[i].recorded = 0;
+  }
+  SampleRing *counters[] = {
+    &scene->forcers_run_samples, &scene->sat_test_samples, &scene->bodies_removed_samples
+  };
+  for (size_t i = 0; i < sizeof(counters) / sizeof(*counters); i++) {
+    double_array_clear(&counters[i]->samples);
+    counters[i]->recorded = 0;
+  }
+  scene_reset_tick_stats(scene);
+}
+
+SceneStats scene_get_stats(Scene *scene) {
+  SceneStats stats;
+  stats.ticks = scene->stage_samples[SCENE_STAGE_TICK].samples.size;
+  for (size_t i = 0; i < SCENE_STAGE_COUNT; i++) {
+    stats.stages[i] = sample_ring_stats(scene, &scene->stage_samples[i]);
+  }
+  stats.forcers_run = sample_ring_stats(scene, &scene->forcers_run_samples);
+  stats.sat_tests = sample_ring_stats(scene, &scene->sat_test_samples);
+  stats.bodies_removed = sample_ring_stats(scene, &scene->bodies_removed_samples);
+  return stats;
+}
+
 Scene *scene_init(void) {
-  Scene* s = malloc(sizeof(Scene));
+  Scene* s = TRACKED_MALLOC(sizeof(Scene));
   assert(s);
 
-  s->num_bodies = 0;
-  s->bodies = list_init(INITIAL_BODIES, (void (*)(void*))body_free);
-  assert(s->bodies);
-
-  s->forcers = list_init(1, (FreeFunc)free);
+  body_array_init(&s->bodies, INITIAL_BODIES);
+  body_array_init(&s->dynamic_bodies, INITIAL_BODIES);
+  body_array_init(&s->kinematic_bodies, 0);
+  body_array_init(&s->static_bodies, 0);
+  forcer_array_init(&s->forcers, INITIAL_FORCERS);
+  force_batch_array_init(&s->batches, 0);
+  forcer_array_init(&s->constraints, 0);
+  s->solver_iterations = DEFAULT_SOLVER_ITERATIONS;
+  s->integrator = INTEGRATOR_TRAPEZOID;
+  s->exact_damping = false;
+  body_array_init(&s->rk4_bodies, 0);
+  vector_array_init(&s->rk4_states, 0);
+  s->stable_removal = true;
+  s->running_forcers = false;
+  s->tick_dt = 0;
+  s->sleep_speed = 0;
+  s->sleep_time = 0;
+  index_array_init(&s->island_parents, 0);
+  double_array_init(&s->island_rest_times, 0);
+  s->substep_motion = 0;
+  s->max_substeps = 1;
+  vector_array_init(&s->substep_saved, 0);
+  vector_array_init(&s->render_vertices, 0);
+  s->stats_window = 0;
+  for (size_t i = 0; i < SCENE_STAGE_COUNT; i++) {
+    sample_ring_init(&s->stage_samples[i]);
+  }
+  sample_ring_init(&s->forcers_run_samples);
+  sample_ring_init(&s->sat_test_samples);
+  sample_ring_init(&s->bodies_removed_samples);
+  scene_reset_tick_stats(s);
+  double_array_init(&s->sorted_samples, 0);
 
   return s;
 }
 
 void scene_free(Scene *scene) {
-  list_free(scene->bodies);
-  for (int i = 0; i < list_size(scene->forcers); i++) {
-    free(((Forcer*)list_get(scene->forcers, i))->bodies);
+  for (size_t i = 0; i < scene->forcers.size; i++) {
+    forcer_free(&scene->forcers.data[i]);
+  }
+  forcer_array_free(&scene->forcers);
+  for (size_t i = 0; i < scene->batches.size; i++) {
+    force_batch_free(&scene->batches.data[i]);
   }
-  list_free(scene->forcers);
-  free(scene);
+  force_batch_array_free(&scene->batches);
+  for (size_t i = 0; i < scene->constraints.size; i++) {
+    forcer_free(&scene->constraints.data[i]);
+  }
+  forcer_array_free(&scene->constraints);
+  for (size_t i = 0; i < scene->bodies.size; i++) {
+    body_free(scene->bodies.data[i]);
+  }
+  body_array_free(&scene->bodies);
+  body_array_free(&scene->dynamic_bodies);
+  body_array_free(&scene->kinematic_bodies);
+  body_array_free(&scene->static_bodies);
+  index_array_free(&scene->island_parents);
+  body_array_free(&scene->rk4_bodies);
+  vector_array_free(&scene->rk4_states);
+  double_array_free(&scene->island_rest_times);
+  vector_array_free(&scene->substep_saved);
+  vector_array_free(&scene->render_vertices);
+  for (size_t i = 0; i < SCENE_STAGE_COUNT; i++) {
+    double_array_free(&scene->stage_samples[i].samples);
+  }
+  double_array_free(&scene->forcers_run_samples.samples);
+  double_array_free(&scene->sat_test_samples.samples);
+  double_array_free(&scene->bodies_removed_samples.samples);
+  double_array_free(&scene->sorted_samples);
+  TRACKED_FREE(scene);
 }
 
 size_t scene_bodies(Scene *scene) {
-  return scene->num_bodies;
+  return scene->bodies.size;
 }
 
 Body *scene_get_body(Scene *scene, size_t index) {
-  assert(index >= 0 && index < scene->num_bodies);
-  return (Body*)list_get(scene->bodies, index);
+  assert(index < scene->bodies.size);
+  return body_array_get(&scene->bodies, index);
 }
 
 void scene_add_body(Scene *scene, Body *body) {
-  list_add(scene->bodies, (void*)body);
-  scene->num_bodies++;
+  body_array_add(&scene->bodies, body);
+  switch (body_get_type(body)) {
+    case BODY_DYNAMIC:
+      body_array_add(&scene->dynamic_bodies, body);
+      break;
+    case BODY_KINEMATIC:
+      body_array_add(&scene->kinematic_bodies, body);
+      break;
+    case BODY_STATIC:
+      body_array_add(&scene->static_bodies, body);
+      break;
+  }
 }
 
 // deprecated
 void scene_remove_body(Scene *scene, size_t index) {
-  assert(index >= 0 && index < scene->num_bodies);
+  assert(index < scene->bodies.size);
   body_remove(scene_get_body(scene, index));
 }
 
 // deprecated
 void scene_add_force_creator(Scene *scene, ForceCreator forcer, void *aux, FreeFunc freer) {
-  scene_add_bodies_force_creator(scene, forcer, aux, list_init(0, free), free);
+  scene_add_bodies_force_creator(scene, forcer, aux, list_init(0, NULL), freer);
+}
+
+Forcer *scene_add_forcer(
+  ForcerArray *forcers, ForceCreator forcer, Body *const *bodies, size_t count
+) {
+  Forcer new_forcer = {.forcer = forcer, .num_bodies = count};
+  Body **forcer_bodies = new_forcer.inline_bodies;
+  if (count > FORCER_INLINE_BODIES) {
+    new_forcer.heap_bodies = TRACKED_MALLOC(count * sizeof(Body*));
+    assert(new_forcer.heap_bodies);
+    forcer_bodies = new_forcer.heap_bodies;
+  }
+  for (size_t i = 0; i < count; i++) {
+    forcer_bodies[i] = bodies[i];
+  }
+  forcer_array_add(forcers, new_forcer);
+  return &forcers->data[forcers->size - 1];
+}
+
+void *forcer_init_inline_aux(Forcer *forcer, size_t aux_size, FreeFunc cleanup) {
+  forcer->freer = cleanup;
+  if (aux_size <= FORCER_INLINE_AUX_SIZE) {
+    forcer->aux_is_inline = true;
+  }
+  else {
+    forcer->aux = TRACKED_MALLOC(aux_size);
+    assert(forcer->aux);
+    forcer->aux_is_owned = true;
+  }
+  return forcer_aux(forcer);
 }
 
 void scene_add_bodies_force_creator(Scene *scene, ForceCreator forcer, void *aux, List *bodies, FreeFunc freer) {
-  Forcer *new_forcer = malloc(sizeof(Forcer));
+  size_t count = list_size(bodies);
+  Body *inline_bodies[FORCER_INLINE_BODIES] = {NULL};
+  Body **body_array = count > FORCER_INLINE_BODIES
+    ? TRACKED_MALLOC(count * sizeof(Body*))
+    : inline_bodies;
+  for (size_t i = 0; i < count; i++) {
+    body_array[i] = (Body*)list_get(bodies, i);
+  }
+  scene_add_force_creator_with_bodies(scene, forcer, aux, body_array, count, freer);
+  if (body_array != inline_bodies) {
+    TRACKED_FREE(body_array);
+  }
+  list_free(bodies);
+}
+
+void scene_add_force_creator_with_bodies(
+  Scene *scene, ForceCreator forcer, void *aux,
+  Body *const *bodies, size_t count, FreeFunc freer
+) {
+  Forcer *new_forcer = scene_add_forcer(&scene->forcers, forcer, bodies, count);
   new_forcer->aux = aux;
-  new_forcer->forcer = forcer;
-  new_forcer->bodies = bodies;
-  list_add(scene->forcers, (void*)new_forcer);
+  new_forcer->freer = freer;
 }
 
-void scene_draw_bodies(Scene *scene) {
-  for (size_t i = 0; i < scene_bodies(scene); i++) {
-    Body *b = scene_get_body(scene, i);
-    List *shape = body_get_shape(b);
-    if (list_size(shape) >= 3) {
-      sdl_draw_polygon(body_get_shape(b), body_get_color(b));
+void scene_add_group_force_creator(
+  Scene *scene, ForceCreator forcer, ForceCreator prune, void *aux,
+  const BodyArray *bodies, FreeFunc freer
+) {
+  Forcer *new_forcer = scene_add_forcer(&scene->forcers, forcer, NULL, 0);
+  new_forcer->prune = prune;
+  new_forcer->group_bodies = bodies;
+  new_forcer->aux = aux;
+  new_forcer->freer = freer;
+}
+
+void *scene_add_inline_force_creator(
+  Scene *scene, ForceCreator forcer, size_t aux_size,
+  Body *const *bodies, size_t count, FreeFunc cleanup
+) {
+  Forcer *new_forcer = scene_add_forcer(&scene->forcers, forcer, bodies, count);
+  return forcer_init_inline_aux(new_forcer, aux_size, cleanup);
+}
+
+void *scene_add_batched_force_creator(
+  Scene *scene, BatchForceCreator batch, size_t params_size,
+  Body *const *bodies, size_t count, FreeFunc cleanup
+) {
+  assert(count <= FORCER_INLINE_BODIES);
+  BatchEntry entry = {.num_bodies = count};
+  for (size_t i = 0; i < count; i++) {
+    entry.bodies[i] = bodies[i];
+  }
+  for (size_t i = 0; i < scene->batches.size; i++) {
+    ForceBatch *existing = &scene->batches.data[i];
+    if (existing->run == batch) {
+      assert(existing->params_size == params_size);
+      return force_batch_add(existing, entry);
     }
   }
+  ForceBatch new_batch = {
+    .run = batch, .params_size = params_size, .cleanup = cleanup,
+    .wake_check = NULL, .params = NULL, .running = false
+  };
+  batch_entry_array_init(&new_batch.entries, 0);
+  pending_entry_array_init(&new_batch.pending, 0);
+  force_batch_array_add(&scene->batches, new_batch);
+  return force_batch_add(&scene->batches.data[scene->batches.size - 1], entry);
+}
+
+void scene_set_batch_wake_check(Scene *scene, BatchForceCreator batch, BatchWakeCheck check) {
+  for (size_t i = 0; i < scene->batches.size; i++) {
+    if (scene->batches.data[i].run == batch) {
+      scene->batches.data[i].wake_check = check;
+      return;
+    }
+  }
+  assert(false);
+}
+
+void *scene_add_constraint(
+  Scene *scene, ForceCreator constraint, size_t aux_size,
+  Body *const *bodies, size_t count, FreeFunc cleanup
+) {
+  return scene_add_iterative_constraint(
+    scene, NULL, constraint, aux_size, bodies, count, cleanup
+  );
+}
+
+void *scene_add_iterative_constraint(
+  Scene *scene, ForceCreator prepare, ForceCreator solve, size_t aux_size,
+  Body *const *bodies, size_t count, FreeFunc cleanup
+) {
+  Forcer *new_constraint = scene_add_forcer(&scene->constraints, solve, bodies, count);
+  new_constraint->prepare = prepare;
+  return forcer_init_inline_aux(new_constraint, aux_size, cleanup);
+}
+
+void scene_set_solver_iterations(Scene *scene, size_t iterations) {
+  assert(iterations > 0);
+  scene->solver_iterations = iterations;
+}
+
+void scene_set_stable_removal(Scene *scene, bool stable) {
+  scene->stable_removal = stable;
+}
+
+void scene_set_integrator(Scene *scene, Integrator integrator) {
+  scene->integrator = integrator;
+}
+
+void scene_set_exact_damping(Scene *scene, bool exact) {
+  scene->exact_damping = exact;
+}
+
+void scene_set_sleeping(Scene *scene, double speed, double time) {
+  scene->sleep_speed = speed;
+  scene->sleep_time = time;
+  if (!scene_sleeping_enabled(scene)) {
+    for (size_t i = 0; i < scene->dynamic_bodies.size; i++) {
+      body_wake(scene->dynamic_bodies.data[i]);
+    }
+  }
+}
+
+bool scene_sleeping_enabled(Scene *scene) {
+  return scene->sleep_speed > 0 && scene->sleep_time > 0;
+}
+
+void scene_set_adaptive_substeps(Scene *scene, double max_motion, size_t max_substeps) {
+  assert(max_substeps > 0);
+  scene->substep_motion = max_motion;
+  scene->max_substeps = max_substeps;
+}
+
+// A force creator has nothing to do if none of its bodies can move
+bool bodies_are_asleep(Body *const *bodies, size_t count) {
+  if (count == 0) {
+    return false;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (bodies[i] == NULL) {
+      continue;
+    }
+    BodyType type = body_get_type(bodies[i]);
+    if (type == BODY_KINEMATIC || (type == BODY_DYNAMIC && !body_is_asleep(bodies[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool forcer_is_asleep(Forcer *forcer) {
+  if (forcer->group_bodies != NULL) {
+    return bodies_are_asleep(forcer->group_bodies->data, forcer->group_bodies->size);
+  }
+  return bodies_are_asleep(forcer_bodies(forcer), forcer->num_bodies);
+}
+
+size_t island_find(size_t *parents, size_t i) {
+  while (parents[i] != i) {
+    // Path halving
+    parents[i] = parents[parents[i]];
+    i = parents[i];
+  }
+  return i;
+}
+
+void island_union(size_t *parents, size_t i, size_t j) {
+  size_t root_i = island_find(parents, i);
+  size_t root_j = island_find(parents, j);
+  if (root_i != root_j) {
+    parents[root_j] = root_i;
+  }
+}
+
+// Puts the dynamic bodies of one force creator in the same island
+void island_union_bodies(size_t *parents, Body *const *bodies, size_t count) {
+  bool have_first = false;
+  size_t first = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (bodies[i] == NULL || body_get_type(bodies[i]) != BODY_DYNAMIC) {
+      continue;
+    }
+    size_t index = body_get_scene_index(bodies[i]);
+    if (!have_first) {
+      first = index;
+      have_first = true;
+    }
+    else {
+      island_union(parents, first, index);
+    }
+  }
+}
+
+void island_union_forcers(size_t *parents, ForcerArray *forcers) {
+  for (size_t i = 0; i < forcers->size; i++) {
+    Forcer *forcer = &forcers->data[i];
+    if (forcer->group_bodies != NULL) {
+      island_union_bodies(parents, forcer->group_bodies->data, forcer->group_bodies->size);
+    }
+    island_union_bodies(parents, forcer_bodies(forcer), forcer->num_bodies);
+  }
+}
+
+void island_union_batches(size_t *parents, ForceBatchArray *batches) {
+  for (size_t i = 0; i < batches->size; i++) {
+    BatchEntryArray *entries = &batches->data[i].entries;
+    for (size_t j = 0; j < entries->size; j++) {
+      island_union_bodies(parents, entries->data[j].bodies, entries->data[j].num_bodies);
+    }
+  }
+}
+
+// Dynamic bodies connected by force creators form an island,
+// which goes to sleep once all of its bodies have been resting for long enough.
+// If any body in a sleeping island is woken up, the whole island wakes up.
+void scene_update_sleeping(Scene *scene, double dt) {
+  size_t n = scene->dynamic_bodies.size;
+  index_array_reserve(&scene->island_parents, n);
+  double_array_reserve(&scene->island_rest_times, n);
+  size_t *parents = scene->island_parents.data;
+  double *rest_times = scene->island_rest_times.data;
+
+  for (size_t i = 0; i < n; i++) {
+    Body *body = scene->dynamic_bodies.data[i];
+    body_set_scene_index(body, i);
+    parents[i] = i;
+    // Sleeping bodies do not stop their island from going to sleep
+    rest_times[i] = body_is_asleep(body)
+      ? INFINITY
+      : body_update_rest_time(body, scene->sleep_speed, dt);
+  }
+
+  island_union_forcers(parents, &scene->forcers);
+  island_union_batches(parents, &scene->batches);
+  island_union_forcers(parents, &scene->constraints);
+
+  // Each island's rest time is the shortest rest time of its bodies.
+  // Only the roots' entries are overwritten, so every body's own entry
+  // is still intact when it is read.
+  for (size_t i = 0; i < n; i++) {
+    size_t root = island_find(parents, i);
+    if (root != i) {
+      rest_times[root] = fmin(rest_times[root], rest_times[i]);
+    }
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    Body *body = scene->dynamic_bodies.data[i];
+    double island_rest_time = rest_times[island_find(parents, i)];
+    // The whole island is already asleep
+    if (island_rest_time == INFINITY) {
+      continue;
+    }
+    if (island_rest_time >= scene->sleep_time) {
+      body_sleep(body);
+    }
+    else if (body_is_asleep(body)) {
+      body_wake(body);
+    }
+  }
+}
+
+void scene_run_forcers(Scene *scene, ForcerArray *forcers, bool sleeping) {
+  // Forcers may add more forcers, so the array is re-read on every iteration
+  scene->running_forcers = true;
+  for (size_t i = 0; i < forcers->size; i++) {
+    Forcer *curr = &forcers->data[i];
+    if (sleeping && forcer_is_asleep(curr)) {
+      continue;
+    }
+    curr->forcer(forcer_aux(curr));
+    scene->forcers_run++;
+  }
+  scene->running_forcers = false;
+}
+
+// Runs each batch with one call, or with one call per run of
+// force creators that are awake if some are asleep
+void scene_run_batches(Scene *scene, bool sleeping) {
+  scene->running_forcers = true;
+  // Batches may be added while running, so the array is re-read every time
+  for (size_t i = 0; i < scene->batches.size; i++) {
+    ForceBatch *batch = &scene->batches.data[i];
+    BatchForceCreator run = batch->run;
+    BatchEntry *entries = batch->entries.data;
+    size_t count = batch->entries.size;
+    batch->running = true;
+    if (!sleeping) {
+      if (count > 0) {
+        run(force_batch_params(batch, 0), count);
+        scene->forcers_run += count;
+      }
+    }
+    else {
+      BatchWakeCheck wake_check = batch->wake_check;
+      size_t start = 0;
+      for (size_t j = 0; j <= count; j++) {
+        if (j < count && (
+          !bodies_are_asleep(entries[j].bodies, entries[j].num_bodies) ||
+          (wake_check != NULL && wake_check(force_batch_params(&scene->batches.data[i], j)))
+        )) {
+          continue;
+        }
+        if (j > start) {
+          run(force_batch_params(&scene->batches.data[i], start), j - start);
+          scene->forcers_run += j - start;
+        }
+        start = j + 1;
+      }
+    }
+    force_batch_finish_running(&scene->batches.data[i]);
+  }
+  scene->running_forcers = false;
+}
+
+void scene_run_force_creators(Scene *scene, bool sleeping) {
+  scene_run_batches(scene, sleeping);
+  scene_run_forcers(scene, &scene->forcers, sleeping);
+}
+
+// The classic fourth-order Runge-Kutta method. The force creators are run
+// three more times, with the bodies moved to the midpoints and end of the step.
+void scene_tick_rk4(Scene *scene, double dt, bool sleeping) {
+  BodyArray *bodies = &scene->rk4_bodies;
+  body_array_clear(bodies);
+  for (size_t i = 0; i < scene->dynamic_bodies.size; i++) {
+    Body *body = scene->dynamic_bodies.data[i];
+    if (!body_is_asleep(body)) {
+      body_array_add(bodies, body);
+    }
+  }
+
+  size_t n = bodies->size;
+  vector_array_reserve(&scene->rk4_states, 6 * n);
+  Vector *start_positions = scene->rk4_states.data;
+  Vector *start_velocities = start_positions + n;
+  // The derivatives of position and velocity at the last stage
+  Vector *stage_velocities = start_velocities + n;
+  Vector *stage_accelerations = stage_velocities + n;
+  // The weighted sums of the stages' derivatives
+  Vector *velocity_sums = stage_accelerations + n;
+  Vector *acceleration_sums = velocity_sums + n;
+
+  // The forces at the start of the step have already been applied
+  for (size_t i = 0; i < n; i++) {
+    Body *body = bodies->data[i];
+    if (!scene->exact_damping && body_has_damping(body)) {
+      body_add_force(body, body_get_damping_force(body));
+    }
+    Vector acceleration = body_take_acceleration(body);
+    start_positions[i] = body_get_centroid(body);
+    start_velocities[i] = body_get_velocity(body);
+    stage_velocities[i] = velocity_sums[i] = start_velocities[i];
+    stage_accelerations[i] = acceleration_sums[i] = acceleration;
+  }
+
+  const double stage_times[] = {.5, .5, 1};
+  const double stage_weights[] = {2, 2, 1};
+  for (size_t stage = 0; stage < 3; stage++) {
+    double stage_dt = stage_times[stage] * dt;
+    for (size_t i = 0; i < n; i++) {
+      Body *body = bodies->data[i];
+      body_set_centroid(body, vec_add(start_positions[i], vec_multiply(stage_dt, stage_velocities[i])));
+      body_set_velocity(body, vec_add(start_velocities[i], vec_multiply(stage_dt, stage_accelerations[i])));
+    }
+    scene_run_force_creators(scene, sleeping);
+    for (size_t i = 0; i < n; i++) {
+      Body *body = bodies->data[i];
+      if (!scene->exact_damping && body_has_damping(body)) {
+        body_add_force(body, body_get_damping_force(body));
+      }
+      stage_velocities[i] = body_get_velocity(body);
+      stage_accelerations[i] = body_take_acceleration(body);
+      double weight = stage_weights[stage];
+      velocity_sums[i] = vec_add(velocity_sums[i], vec_multiply(weight, stage_velocities[i]));
+      acceleration_sums[i] = vec_add(acceleration_sums[i], vec_multiply(weight, stage_accelerations[i]));
+    }
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    Body *body = bodies->data[i];
+    body_set_centroid(body, vec_add(start_positions[i], vec_multiply(dt / 6, velocity_sums[i])));
+    body_set_velocity(body, vec_add(start_velocities[i], vec_multiply(dt / 6, acceleration_sums[i])));
+    if (scene->exact_damping) {
+      body_apply_damping(body, dt);
+    }
+  }
+}
+
+// How many steps a body needs so that it moves no more than
+// substep_motion times the smaller side of its bounding box in each one
+size_t body_substeps(Scene *scene, Body *body, double dt) {
+  Vector min, max;
+  body_get_bounds(body, &min, &max);
+  double allowed = scene->substep_motion * fmin(max.x - min.x, max.y - min.y);
+  double mass = body_get_mass(body);
+  if (allowed <= 0 || mass == INFINITY) {
+    return 1;
+  }
+  Vector velocity = vec_add(body_get_velocity(body), vec_multiply(1 / mass, body_get_impulse(body)));
+  Vector acceleration = vec_multiply(1 / mass, body_get_force(body));
+  double motion = sqrt(vec_dot(velocity, velocity)) * dt
+    + .5 * sqrt(vec_dot(acceleration, acceleration)) * dt * dt;
+  if (motion <= allowed) {
+    return 1;
+  }
+  double substeps = ceil(motion / allowed);
+  return substeps < scene->max_substeps ? (size_t)substeps : scene->max_substeps;
+}
+
+bool bodies_contain(Body *const *bodies, size_t count, Body *body) {
+  for (size_t i = 0; i < count; i++) {
+    if (bodies[i] == body) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Remembers the forces and impulses on the bodies of a force creator
+// before it is run again on behalf of one of them
+void scene_save_accumulated(Scene *scene, Body *const *bodies, size_t count) {
+  vector_array_reserve(&scene->substep_saved, 2 * count);
+  for (size_t i = 0; i < count; i++) {
+    scene->substep_saved.data[2 * i] = body_get_force(bodies[i]);
+    scene->substep_saved.data[2 * i + 1] = body_get_impulse(bodies[i]);
+  }
+}
+
+void scene_restore_accumulated(Scene *scene, Body *const *bodies, size_t count, Body *keep) {
+  for (size_t i = 0; i < count; i++) {
+    if (bodies[i] != keep) {
+      Vector *saved = &scene->substep_saved.data[2 * i];
+      body_set_accumulated(bodies[i], saved[0], saved[1]);
+    }
+  }
+}
+
+// Runs the force creators acting on a body again, keeping only the forces
+// they apply to that body. Force creators not given their bodies are skipped.
+void scene_rerun_forcers_on(Scene *scene, Body *body) {
+  scene->running_forcers = true;
+  for (size_t i = 0; i < scene->batches.size; i++) {
+    ForceBatch *batch = &scene->batches.data[i];
+    batch->running = true;
+    for (size_t j = 0; j < batch->entries.size; j++) {
+      BatchEntry *entry = &batch->entries.data[j];
+      if (!bodies_contain(entry->bodies, entry->num_bodies, body)) {
+        continue;
+      }
+      scene_save_accumulated(scene, entry->bodies, entry->num_bodies);
+      batch->run(force_batch_params(batch, j), 1);
+      scene->forcers_run++;
+      // Running the batch may have added batches, moving this one
+      batch = &scene->batches.data[i];
+      scene_restore_accumulated(scene, entry->bodies, entry->num_bodies, body);
+    }
+    force_batch_finish_running(batch);
+  }
+  for (size_t i = 0; i < scene->forcers.size; i++) {
+    Forcer *curr = &scene->forcers.data[i];
+    if (!bodies_contain(forcer_bodies(curr), curr->num_bodies, body)) {
+      continue;
+    }
+    scene_save_accumulated(scene, forcer_bodies(curr), curr->num_bodies);
+    curr->forcer(forcer_aux(curr));
+    scene->forcers_run++;
+    // The force creator may have added forcers, moving this one
+    curr = &scene->forcers.data[i];
+    scene_restore_accumulated(scene, forcer_bodies(curr), curr->num_bodies, body);
+  }
+  scene->running_forcers = false;
+}
+
+// Ticks a body, damping it either with a force integrated along with the others,
+// or by exact decay after the step
+void scene_tick_damped(Scene *scene, Body *body, void (*tick)(Body*, double), double dt) {
+  bool damped = body_has_damping(body);
+  if (damped && !scene->exact_damping) {
+    body_add_force(body, body_get_damping_force(body));
+  }
+  tick(body, dt);
+  if (damped && scene->exact_damping) {
+    body_apply_damping(body, dt);
+  }
+}
+
+void scene_integrate(Scene *scene, double dt, bool sleeping) {
+  void (*tick)(Body*, double);
+  switch (scene->integrator) {
+    case INTEGRATOR_RK4:
+      scene_tick_rk4(scene, dt, sleeping);
+      return;
+    case INTEGRATOR_SYMPLECTIC_EULER:
+      tick = body_tick_symplectic_euler;
+      break;
+    case INTEGRATOR_VELOCITY_VERLET:
+      tick = body_tick_verlet;
+      break;
+    default:
+      tick = body_tick;
+      break;
+  }
+  for (size_t i = 0; i < scene->dynamic_bodies.size; i++) {
+    Body *body = scene->dynamic_bodies.data[i];
+    if (body_is_asleep(body)) {
+      continue;
+    }
+    size_t substeps = scene->substep_motion > 0 ? body_substeps(scene, body, dt) : 1;
+    double substep_dt = dt / substeps;
+    // The first substep uses the forces from the start of the tick
+    scene_tick_damped(scene, body, tick, substep_dt);
+    for (size_t j = 1; j < substeps; j++) {
+      scene_rerun_forcers_on(scene, body);
+      scene_tick_damped(scene, body, tick, substep_dt);
+    }
+  }
+}
+
+double scene_get_tick_dt(Scene *scene) {
+  return scene->tick_dt;
 }
 
 void scene_tick(Scene *scene, double dt) {
-  for (size_t i = 0; i < list_size(scene->forcers); i++) {
-    Forcer *curr = (Forcer*)list_get(scene->forcers, i);
-    curr->forcer(curr->aux);
+  // Work done between ticks, e.g. by calling scene_tick_delete_only(), is not counted
+  if (scene->stats_window > 0) {
+    scene_reset_tick_stats(scene);
+  }
+  double tick_start = scene_stats_clock(scene);
+  scene->tick_dt = dt;
+  // Static and sleeping bodies don't move, so their saved states stay valid
+  for (size_t i = 0; i < scene->dynamic_bodies.size; i++) {
+    Body *body = scene->dynamic_bodies.data[i];
+    if (!body_is_asleep(body)) {
+      body_save_state(body);
+    }
+  }
+  for (size_t i = 0; i < scene->kinematic_bodies.size; i++) {
+    body_save_state(scene->kinematic_bodies.data[i]);
   }
+  bool sleeping = scene_sleeping_enabled(scene);
+  double stage_start = scene_stats_clock(scene);
+  scene_run_force_creators(scene, sleeping);
+  stage_start = scene_end_stage(scene, SCENE_STAGE_FORCES, stage_start);
 
-  for (size_t i = 0; i < scene->num_bodies; i++) {
-    body_tick(scene_get_body(scene, i), dt);
+  scene_integrate(scene, dt, sleeping);
+  for (size_t i = 0; i < scene->kinematic_bodies.size; i++) {
+    body_tick_kinematic(scene->kinematic_bodies.data[i], dt);
   }
+  stage_start = scene_end_stage(scene, SCENE_STAGE_INTEGRATE, stage_start);
+
+  // The constraints are solved together by sequential impulses:
+  // each iteration applies every constraint once, so the corrections
+  // made by one constraint are seen by the ones after it
+  scene->running_forcers = true;
+  for (size_t i = 0; i < scene->constraints.size; i++) {
+    Forcer *curr = &scene->constraints.data[i];
+    if (curr->prepare != NULL && !(sleeping && forcer_is_asleep(curr))) {
+      curr->prepare(forcer_aux(curr));
+    }
+  }
+  scene->running_forcers = false;
+  for (size_t i = 0; i < scene->solver_iterations; i++) {
+    scene_run_forcers(scene, &scene->constraints, sleeping);
+  }
+  scene_end_stage(scene, SCENE_STAGE_CONSTRAINTS, stage_start);
 
   scene_tick_delete_only(scene);
 
-  scene_draw_bodies(scene);
+  stage_start = scene_stats_clock(scene);
+  if (sleeping) {
+    scene_update_sleeping(scene, dt);
+  }
+  if (scene->stats_window > 0) {
+    double end = scene_end_stage(scene, SCENE_STAGE_SLEEP, stage_start);
+    scene->stage_times[SCENE_STAGE_TICK] = end - tick_start;
+    scene_record_tick(scene);
+  }
+}
+
+bool forcer_has_removed_body(Forcer *forcer) {
+  Body **bodies = forcer_bodies(forcer);
+  for (size_t i = 0; i < forcer->num_bodies; i++) {
+    if (body_is_removed(bodies[i])) {
+      return true;
+    }
+  }
+  return false;
+}
 
+bool body_slot_is_removed(Body **body) {
+  return body_is_removed(*body);
 }
 
-void scene_tick_delete_only(Scene *scene) {
-  for (size_t i = 0; i < list_size(scene->forcers); i++) {
-    Forcer *curr = (Forcer*)list_get(scene->forcers, i);
-    for (size_t j = 0; j < list_size(curr->bodies); j++) {
-      if (body_is_removed(list_get(curr->bodies, j))) {
-        Forcer *rem = list_remove(scene->forcers, i);
-        free(rem->bodies);
-        free(rem);
-        i--;
-        break;
+void body_slot_free(Body **body) {
+  body_free(*body);
+}
+
+// Removes the force creators with removed bodies, keeping the rest in order
+void force_batch_reap(ForceBatch *batch) {
+  size_t kept = 0;
+  for (size_t i = 0; i < batch->entries.size; i++) {
+    BatchEntry *entry = &batch->entries.data[i];
+    bool removed = false;
+    for (size_t j = 0; j < entry->num_bodies; j++) {
+      removed = removed || body_is_removed(entry->bodies[j]);
+    }
+    if (removed) {
+      if (batch->cleanup != NULL) {
+        batch->cleanup(force_batch_params(batch, i));
       }
+      continue;
+    }
+    if (kept != i) {
+      batch->entries.data[kept] = *entry;
+      memcpy(force_batch_params(batch, kept), force_batch_params(batch, i), batch->params_size);
     }
+    kept++;
   }
+  batch->entries.size = kept;
+}
+
+void scene_render(Scene *scene, SceneView *view, double alpha) {
+  double start = scene_stats_clock(scene);
+  for (size_t i = 0; i < scene->bodies.size; i++) {
+    Body *body = scene->bodies.data[i];
+    const VectorArray *vertices;
+    // Static bodies never move, so there is nothing to interpolate
+    if (alpha >= 1 || body_get_type(body) == BODY_STATIC) {
+      vertices = body_get_vertices(body);
+    }
+    else {
+      body_get_interpolated_vertices(body, alpha, &scene->render_vertices);
+      vertices = &scene->render_vertices;
+    }
+    if (vertices->size >= 3) {
+      view->draw_polygon(view->aux, vertices->data, vertices->size, body_get_color(body));
+    }
+  }
+  if (scene->stats_window > 0) {
+    sample_ring_add(
+      &scene->stage_samples[SCENE_STAGE_RENDER], scene->stats_window,
+      scene_stats_clock(scene) - start
+    );
+  }
+}
 
-  for (size_t i = 0; i < scene->num_bodies; i++) {
-    Body *b = list_get(scene->bodies, i);
+void scene_tick_delete_only(Scene *scene) {
+  // Reaping now would free the aux of the forcer that is currently running,
+  // so wait for scene_tick() to reap once all the forcers have run
+  if (scene->running_forcers) {
+    return;
+  }
+
+  double start = scene_stats_clock(scene);
+  bool any_removed = false;
+  for (size_t i = 0; i < scene->bodies.size; i++) {
+    if (body_is_removed(scene->bodies.data[i])) {
+      any_removed = true;
+      break;
+    }
+  }
+  if (!any_removed) {
+    scene_end_stage(scene, SCENE_STAGE_REAP_BODIES, start);
+    return;
+  }
 
-    if (body_is_removed(b)) {
-      body_free(list_remove(scene->bodies, i));
-      scene->num_bodies--;
-      i--;
+  // Forcers must be reaped first, since they may refer to the removed bodies
+  forcer_array_remove_if(
+    &scene->forcers, forcer_has_removed_body, forcer_free, true
+  );
+  forcer_array_remove_if(
+    &scene->constraints, forcer_has_removed_body, forcer_free, true
+  );
+  for (size_t i = 0; i < scene->batches.size; i++) {
+    force_batch_reap(&scene->batches.data[i]);
+  }
+  for (size_t i = 0; i < scene->forcers.size; i++) {
+    Forcer *curr = &scene->forcers.data[i];
+    if (curr->prune != NULL) {
+      curr->prune(forcer_aux(curr));
     }
   }
+  start = scene_end_stage(scene, SCENE_STAGE_REAP_FORCERS, start);
+
+  // The partitions only refer to the bodies, so they are reaped before
+  // the bodies are freed
+  body_array_remove_if(
+    &scene->dynamic_bodies, body_slot_is_removed, NULL, scene->stable_removal
+  );
+  body_array_remove_if(
+    &scene->kinematic_bodies, body_slot_is_removed, NULL, scene->stable_removal
+  );
+  body_array_remove_if(
+    &scene->static_bodies, body_slot_is_removed, NULL, scene->stable_removal
+  );
+  scene->bodies_removed += body_array_remove_if(
+    &scene->bodies, body_slot_is_removed, body_slot_free, scene->stable_removal
+  );
+  scene_end_stage(scene, SCENE_STAGE_REAP_BODIES, start);
 }
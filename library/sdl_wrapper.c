@@ -1,3 +1,4 @@
+#define ALLOC_TAG ALLOC_RENDER
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
@@ -7,6 +8,7 @@
 #include <SDL2/SDL_image.h>
 #include <time.h>
 #include "sdl_wrapper.h"
+#include "alloc_tracker.h"
 
 #define WINDOW_TITLE "CS 3"
 #define WINDOW_WIDTH 800
@@ -89,12 +91,12 @@ void sdl_quit(void) {
 }
 
 bool sdl_is_done(void) {
-    SDL_Event *event = malloc(sizeof(*event));
+    SDL_Event *event = TRACKED_MALLOC(sizeof(*event));
     assert(event);
     while (SDL_PollEvent(event)) {
         switch (event->type) {
             case SDL_QUIT:
-                free(event);
+                TRACKED_FREE(event);
                 return true;
             case SDL_KEYDOWN:
             case SDL_KEYUP:
@@ -116,7 +118,7 @@ bool sdl_is_done(void) {
                 break;
         }
     }
-    free(event);
+    TRACKED_FREE(event);
     return false;
 }
 
@@ -125,9 +127,8 @@ void sdl_clear(void) {
     SDL_RenderClear(renderer);
 }
 
-void sdl_draw_polygon(List *points, RGBColor color) {
+void sdl_draw_vertices(const Vector *vertices, size_t n, RGBColor color) {
     // Check parameters
-    size_t n = list_size(points);
     assert(n >= 3);
     if (color.r != -1 || color.g != -1 || color.b != -1) {
       assert(0 <= color.r && color.r <= 1);
@@ -137,28 +138,27 @@ void sdl_draw_polygon(List *points, RGBColor color) {
 
     // Scale scene so it fits entirely in the window,
     // with the center of the scene at the center of the window
-    int *width = malloc(sizeof(*width)),
-        *height = malloc(sizeof(*height));
+    int *width = TRACKED_MALLOC(sizeof(*width)),
+        *height = TRACKED_MALLOC(sizeof(*height));
     assert(width);
     assert(height);
     SDL_GetWindowSize(window, width, height);
     double center_x = *width / 2.0,
            center_y = *height / 2.0;
-    free(width);
-    free(height);
+    TRACKED_FREE(width);
+    TRACKED_FREE(height);
     double x_scale = center_x / max_diff.x,
            y_scale = center_y / max_diff.y;
     double scale = x_scale < y_scale ? x_scale : y_scale;
 
     // Convert each vertex to a point on screen
-    short *x_points = malloc(sizeof(*x_points) * n),
-          *y_points = malloc(sizeof(*y_points) * n);
+    short *x_points = TRACKED_MALLOC(sizeof(*x_points) * n),
+          *y_points = TRACKED_MALLOC(sizeof(*y_points) * n);
     assert(x_points);
     assert(y_points);
     for (size_t i = 0; i < n; i++) {
-        Vector *vertex = list_get(points, i);
         Vector pos_from_center =
-            vec_multiply(scale, vec_subtract(*vertex, center));
+            vec_multiply(scale, vec_subtract(vertices[i], center));
         // Flip y axis since positive y is down on the screen
         x_points[i] = round(center_x + pos_from_center.x);
         y_points[i] = round(center_y - pos_from_center.y);
@@ -179,8 +179,19 @@ void sdl_draw_polygon(List *points, RGBColor color) {
           color.r * 255, color.g * 255, color.b * 255, 255
       );
     }
-    free(x_points);
-    free(y_points);
+    TRACKED_FREE(x_points);
+    TRACKED_FREE(y_points);
+}
+
+void sdl_draw_polygon(List *points, RGBColor color) {
+    size_t n = list_size(points);
+    VectorArray vertices;
+    vector_array_init(&vertices, n);
+    for (size_t i = 0; i < n; i++) {
+        vector_array_add(&vertices, *(Vector *) list_get(points, i));
+    }
+    sdl_draw_vertices(vertices.data, vertices.size, color);
+    vector_array_free(&vertices);
 }
 
 void sdl_draw_pie(Vector pos, int rad, int start, int end, RGBColor color) {
@@ -188,15 +199,15 @@ void sdl_draw_pie(Vector pos, int rad, int start, int end, RGBColor color) {
 
     // Scale scene so it fits entirely in the window,
     // with the center of the scene at the center of the window
-    int *width = malloc(sizeof(*width)),
-        *height = malloc(sizeof(*height));
+    int *width = TRACKED_MALLOC(sizeof(*width)),
+        *height = TRACKED_MALLOC(sizeof(*height));
     assert(width);
     assert(height);
     SDL_GetWindowSize(window, width, height);
     double center_x = *width / 2.0,
            center_y = *height / 2.0;
-    free(width);
-    free(height);
+    TRACKED_FREE(width);
+    TRACKED_FREE(height);
     double x_scale = center_x / max_diff.x,
            y_scale = center_y / max_diff.y;
     double scale = x_scale < y_scale ? x_scale : y_scale;
@@ -221,15 +232,18 @@ void sdl_show(void) {
     SDL_RenderPresent(renderer);
 }
 
+void sdl_view_draw_polygon(void *aux, const Vector *vertices, size_t count, RGBColor color) {
+    sdl_draw_vertices(vertices, count, color);
+}
+
+SceneView sdl_scene_view(void) {
+    return (SceneView){.draw_polygon = sdl_view_draw_polygon, .aux = NULL};
+}
+
 void sdl_render_scene(Scene *scene) {
+    SceneView view = sdl_scene_view();
     sdl_clear();
-    size_t body_count = scene_bodies(scene);
-    for (size_t i = 0; i < body_count; i++) {
-        Body *body = scene_get_body(scene, i);
-        List *shape = body_get_shape(body);
-        sdl_draw_polygon(shape, body_get_color(body));
-        list_free(shape);
-    }
+    scene_render(scene, &view, 1);
     sdl_show();
 }
 
@@ -257,6 +271,7 @@ void sdl_show_text_fast(int x, int y, int width, int height, SDL_Surface* surfac
   SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
   SDL_Rect str_rect = {.x = x, .y = y, .w = width, .h = height};
   SDL_RenderCopy(renderer, texture, NULL, &str_rect);
+  SDL_DestroyTexture(texture);
 }
 
 double time_since_last_tick(void) {
@@ -279,6 +294,7 @@ SDL_Texture *sdl_load_image(char *path) {
   }
 
   SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, image);
+  SDL_FreeSurface(image);
   return texture;
 }
 
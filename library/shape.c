@@ -0,0 +1,83 @@
+#define ALLOC_TAG ALLOC_SHAPE
+#include "shape.h"
+#include "alloc_tracker.h"
+#include "polygon.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+struct shape {
+  size_t references;
+  VectorArray vertices;
+  VectorArray normals;
+  double area;
+  Vector centroid;
+  Vector min;
+  Vector max;
+};
+
+Shape *shape_init(List *points) {
+  Shape *shape = TRACKED_MALLOC(sizeof(Shape));
+  assert(shape);
+  shape->references = 1;
+
+  size_t n = list_size(points);
+  vector_array_init(&shape->vertices, n);
+  for (size_t i = 0; i < n; i++) {
+    vector_array_add(&shape->vertices, *(Vector*)list_get(points, i));
+  }
+  list_free(points);
+
+  PolygonMetrics metrics = polygon_metrics(shape->vertices.data, n);
+  shape->area = fabs(metrics.area);
+  shape->centroid = metrics.centroid;
+  shape->min = vec_subtract(metrics.min, metrics.centroid);
+  shape->max = vec_subtract(metrics.max, metrics.centroid);
+  polygon_translate_array(&shape->vertices, vec_negate(metrics.centroid));
+
+  // Clockwise polygons have negative signed area,
+  // so their normals need to be flipped to point outwards
+  vector_array_init(&shape->normals, n);
+  polygon_edge_normals(
+    shape->vertices.data, n, metrics.area < 0 ? -1 : 1, shape->normals.data
+  );
+  shape->normals.size = n;
+
+  return shape;
+}
+
+Shape *shape_retain(Shape *shape) {
+  shape->references++;
+  return shape;
+}
+
+void shape_release(Shape *shape) {
+  assert(shape->references > 0);
+  shape->references--;
+  if (shape->references == 0) {
+    vector_array_free(&shape->vertices);
+    vector_array_free(&shape->normals);
+    TRACKED_FREE(shape);
+  }
+}
+
+const VectorArray *shape_get_vertices(Shape *shape) {
+  return &shape->vertices;
+}
+
+const VectorArray *shape_get_normals(Shape *shape) {
+  return &shape->normals;
+}
+
+double shape_get_area(Shape *shape) {
+  return shape->area;
+}
+
+Vector shape_get_centroid(Shape *shape) {
+  return shape->centroid;
+}
+
+void shape_get_bounds(Shape *shape, Vector *min, Vector *max) {
+  *min = shape->min;
+  *max = shape->max;
+}
@@ -0,0 +1,331 @@
+#define ALLOC_TAG ALLOC_FORCER
+#include "spring_network.h"
+#include "alloc_tracker.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+// The most conjugate gradient iterations an implicit network runs per tick
+#define SPRING_NETWORK_MAX_ITERATIONS 100
+// The implicit solve stops once its residual shrinks by this factor
+#define SPRING_NETWORK_TOLERANCE 1e-10
+
+typedef struct {
+  size_t node1;
+  size_t node2;
+  double k;
+  double rest_length;
+} NetworkSpring;
+
+DEFINE_ARRAY(NetworkSpringArray, network_spring_array, NetworkSpring)
+DEFINE_ARRAY(IndexArray, index_array, size_t)
+DEFINE_ARRAY(DoubleArray, double_array, double)
+
+struct spring_network {
+  Scene *scene;
+  bool implicit;
+  // Removed bodies are replaced by NULL, so the other indices stay valid
+  BodyArray bodies;
+  // The springs as they were added, from which the rows are rebuilt
+  NetworkSpringArray springs;
+  bool rows_stale;
+  // Each spring is stored once, in the row of its lower-numbered body:
+  // row i holds entries row_starts[i] to row_starts[i + 1] - 1
+  IndexArray row_starts;
+  IndexArray columns;
+  DoubleArray stiffnesses;
+  DoubleArray rest_lengths;
+  // Rebuilt every tick, indexed by body. Anchors have mass INFINITY.
+  VectorArray positions;
+  DoubleArray masses;
+  VectorArray forces;
+  // The conjugate gradient method's vectors
+  VectorArray velocities;
+  VectorArray residuals;
+  VectorArray directions;
+  VectorArray products;
+};
+
+void spring_network_free(SpringNetwork *network) {
+  body_array_free(&network->bodies);
+  network_spring_array_free(&network->springs);
+  index_array_free(&network->row_starts);
+  index_array_free(&network->columns);
+  double_array_free(&network->stiffnesses);
+  double_array_free(&network->rest_lengths);
+  vector_array_free(&network->positions);
+  double_array_free(&network->masses);
+  vector_array_free(&network->forces);
+  vector_array_free(&network->velocities);
+  vector_array_free(&network->residuals);
+  vector_array_free(&network->directions);
+  vector_array_free(&network->products);
+  TRACKED_FREE(network);
+}
+
+void SpringNetworkPrune(void *aux) {
+  SpringNetwork *network = (SpringNetwork*)aux;
+  bool any_removed = false;
+  for (size_t i = 0; i < network->bodies.size; i++) {
+    Body *body = network->bodies.data[i];
+    if (body != NULL && body_is_removed(body)) {
+      network->bodies.data[i] = NULL;
+      any_removed = true;
+    }
+  }
+  if (!any_removed) {
+    return;
+  }
+  size_t kept = 0;
+  for (size_t i = 0; i < network->springs.size; i++) {
+    NetworkSpring spring = network->springs.data[i];
+    if (network->bodies.data[spring.node1] != NULL && network->bodies.data[spring.node2] != NULL) {
+      network->springs.data[kept++] = spring;
+    }
+  }
+  network->springs.size = kept;
+  network->rows_stale = true;
+}
+
+SpringNetwork *create_spring_network(Scene *scene) {
+  SpringNetwork *network = TRACKED_MALLOC(sizeof(SpringNetwork));
+  assert(network);
+  network->scene = scene;
+  network->implicit = false;
+  body_array_init(&network->bodies, 0);
+  network_spring_array_init(&network->springs, 0);
+  network->rows_stale = true;
+  index_array_init(&network->row_starts, 0);
+  index_array_init(&network->columns, 0);
+  double_array_init(&network->stiffnesses, 0);
+  double_array_init(&network->rest_lengths, 0);
+  vector_array_init(&network->positions, 0);
+  double_array_init(&network->masses, 0);
+  vector_array_init(&network->forces, 0);
+  vector_array_init(&network->velocities, 0);
+  vector_array_init(&network->residuals, 0);
+  vector_array_init(&network->directions, 0);
+  vector_array_init(&network->products, 0);
+  scene_add_group_force_creator(
+    scene, SpringNetworkForceCreator, SpringNetworkPrune, network,
+    &network->bodies, (FreeFunc)spring_network_free
+  );
+  return network;
+}
+
+size_t spring_network_add_body(SpringNetwork *network, Body *body) {
+  body_array_add(&network->bodies, body);
+  network->rows_stale = true;
+  return network->bodies.size - 1;
+}
+
+void spring_network_add_spring(
+  SpringNetwork *network, size_t node1, size_t node2, double k, double rest_length
+) {
+  assert(node1 < network->bodies.size && node2 < network->bodies.size);
+  assert(node1 != node2);
+  NetworkSpring spring = {
+    .node1 = node1 < node2 ? node1 : node2,
+    .node2 = node1 < node2 ? node2 : node1,
+    .k = k,
+    .rest_length = rest_length
+  };
+  network_spring_array_add(&network->springs, spring);
+  network->rows_stale = true;
+}
+
+size_t spring_network_springs(SpringNetwork *network) {
+  return network->springs.size;
+}
+
+void spring_network_set_implicit(SpringNetwork *network, bool implicit) {
+  network->implicit = implicit;
+}
+
+// Sorts the springs into rows by their lower-numbered body
+void spring_network_build_rows(SpringNetwork *network) {
+  size_t n = network->bodies.size;
+  size_t count = network->springs.size;
+  index_array_reserve(&network->row_starts, n + 1);
+  index_array_reserve(&network->columns, count);
+  double_array_reserve(&network->stiffnesses, count);
+  double_array_reserve(&network->rest_lengths, count);
+  network->row_starts.size = n + 1;
+  network->columns.size = network->stiffnesses.size = network->rest_lengths.size = count;
+
+  size_t *row_starts = network->row_starts.data;
+  for (size_t i = 0; i <= n; i++) {
+    row_starts[i] = 0;
+  }
+  for (size_t i = 0; i < count; i++) {
+    row_starts[network->springs.data[i].node1 + 1]++;
+  }
+  for (size_t i = 0; i < n; i++) {
+    row_starts[i + 1] += row_starts[i];
+  }
+  // row_starts[i] is used as row i's cursor, leaving it at the start of row i + 1
+  for (size_t i = 0; i < count; i++) {
+    NetworkSpring spring = network->springs.data[i];
+    size_t entry = row_starts[spring.node1]++;
+    network->columns.data[entry] = spring.node2;
+    network->stiffnesses.data[entry] = spring.k;
+    network->rest_lengths.data[entry] = spring.rest_length;
+  }
+  for (size_t i = n; i > 0; i--) {
+    row_starts[i] = row_starts[i - 1];
+  }
+  row_starts[0] = 0;
+  network->rows_stale = false;
+}
+
+// Computes every spring's force once, applying it to both of its bodies
+void spring_network_forces(SpringNetwork *network) {
+  size_t n = network->bodies.size;
+  const size_t *row_starts = network->row_starts.data;
+  const Vector *positions = network->positions.data;
+  Vector *forces = network->forces.data;
+  for (size_t i = 0; i < n; i++) {
+    forces[i] = VEC_ZERO;
+  }
+  for (size_t i = 0; i < n; i++) {
+    for (size_t entry = row_starts[i]; entry < row_starts[i + 1]; entry++) {
+      size_t j = network->columns.data[entry];
+      Vector d = vec_subtract(positions[j], positions[i]);
+      double scale = network->stiffnesses.data[entry];
+      double rest_length = network->rest_lengths.data[entry];
+      if (rest_length != 0) {
+        double length = sqrt(vec_dot(d, d));
+        scale = length > 0 ? scale * (length - rest_length) / length : 0;
+      }
+      Vector force = vec_multiply(scale, d);
+      forces[i] = vec_add(forces[i], force);
+      forces[j] = vec_subtract(forces[j], force);
+    }
+  }
+}
+
+// Adds scale times the springs' stiffness matrix (the weighted graph
+// Laplacian) times in to out
+void spring_network_add_laplacian(SpringNetwork *network, double scale, const Vector *in, Vector *out) {
+  size_t n = network->bodies.size;
+  const size_t *row_starts = network->row_starts.data;
+  for (size_t i = 0; i < n; i++) {
+    for (size_t entry = row_starts[i]; entry < row_starts[i + 1]; entry++) {
+      size_t j = network->columns.data[entry];
+      double weight = scale * network->stiffnesses.data[entry];
+      Vector difference = vec_multiply(weight, vec_subtract(in[i], in[j]));
+      out[i] = vec_add(out[i], difference);
+      out[j] = vec_subtract(out[j], difference);
+    }
+  }
+}
+
+double spring_network_dot(SpringNetwork *network, const Vector *a, const Vector *b) {
+  double sum = 0;
+  for (size_t i = 0; i < network->bodies.size; i++) {
+    sum += vec_dot(a[i], b[i]);
+  }
+  return sum;
+}
+
+// Solves (M + dt^2 K) v' = M v + dt F for the velocities v' at the end of
+// the tick, by the conjugate gradient method, with the anchors' velocities fixed.
+// Then replaces each force with the one that changes v to v' in one step.
+void spring_network_solve(SpringNetwork *network, double dt) {
+  size_t n = network->bodies.size;
+  const double *masses = network->masses.data;
+  Vector *forces = network->forces.data;
+  Vector *velocities = network->velocities.data;
+  Vector *residuals = network->residuals.data;
+  Vector *directions = network->directions.data;
+  Vector *products = network->products.data;
+
+  // Starting from v' = v, the residual is dt F - dt^2 K v
+  for (size_t i = 0; i < n; i++) {
+    Body *body = network->bodies.data[i];
+    velocities[i] = body != NULL ? body_get_velocity(body) : VEC_ZERO;
+    residuals[i] = vec_multiply(dt, forces[i]);
+  }
+  spring_network_add_laplacian(network, -dt * dt, velocities, residuals);
+  for (size_t i = 0; i < n; i++) {
+    if (masses[i] == INFINITY) {
+      residuals[i] = VEC_ZERO;
+    }
+    directions[i] = residuals[i];
+  }
+
+  double residual_norm = spring_network_dot(network, residuals, residuals);
+  double target = residual_norm * SPRING_NETWORK_TOLERANCE * SPRING_NETWORK_TOLERANCE;
+  for (size_t iteration = 0; iteration < SPRING_NETWORK_MAX_ITERATIONS; iteration++) {
+    if (residual_norm <= target || residual_norm == 0) {
+      break;
+    }
+    for (size_t i = 0; i < n; i++) {
+      products[i] = masses[i] == INFINITY ? VEC_ZERO : vec_multiply(masses[i], directions[i]);
+    }
+    spring_network_add_laplacian(network, dt * dt, directions, products);
+    for (size_t i = 0; i < n; i++) {
+      if (masses[i] == INFINITY) {
+        products[i] = VEC_ZERO;
+      }
+    }
+    double alpha = residual_norm / spring_network_dot(network, directions, products);
+    for (size_t i = 0; i < n; i++) {
+      velocities[i] = vec_add(velocities[i], vec_multiply(alpha, directions[i]));
+      residuals[i] = vec_subtract(residuals[i], vec_multiply(alpha, products[i]));
+    }
+    double new_residual_norm = spring_network_dot(network, residuals, residuals);
+    double beta = new_residual_norm / residual_norm;
+    for (size_t i = 0; i < n; i++) {
+      directions[i] = vec_add(residuals[i], vec_multiply(beta, directions[i]));
+    }
+    residual_norm = new_residual_norm;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    if (masses[i] != INFINITY) {
+      Vector change = vec_subtract(velocities[i], body_get_velocity(network->bodies.data[i]));
+      forces[i] = vec_multiply(masses[i] / dt, change);
+    }
+  }
+}
+
+void SpringNetworkForceCreator(void *aux) {
+  SpringNetwork *network = (SpringNetwork*)aux;
+  if (network->springs.size == 0) {
+    return;
+  }
+  if (network->rows_stale) {
+    spring_network_build_rows(network);
+  }
+
+  size_t n = network->bodies.size;
+  vector_array_reserve(&network->positions, n);
+  double_array_reserve(&network->masses, n);
+  vector_array_reserve(&network->forces, n);
+  network->positions.size = network->masses.size = network->forces.size = n;
+  for (size_t i = 0; i < n; i++) {
+    Body *body = network->bodies.data[i];
+    bool anchored = body == NULL || body_get_type(body) != BODY_DYNAMIC;
+    network->positions.data[i] = body != NULL ? body_get_centroid(body) : VEC_ZERO;
+    network->masses.data[i] = anchored ? INFINITY : body_get_mass(body);
+  }
+  spring_network_forces(network);
+
+  double dt = scene_get_tick_dt(network->scene);
+  if (network->implicit && dt > 0) {
+    vector_array_reserve(&network->velocities, n);
+    vector_array_reserve(&network->residuals, n);
+    vector_array_reserve(&network->directions, n);
+    vector_array_reserve(&network->products, n);
+    network->velocities.size = network->residuals.size = n;
+    network->directions.size = network->products.size = n;
+    spring_network_solve(network, dt);
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    if (network->masses.data[i] != INFINITY) {
+      body_add_force(network->bodies.data[i], network->forces.data[i]);
+    }
+  }
+}
@@ -0,0 +1,69 @@
+#include "alloc_tracker.h"
+#include "polygon_helper.h"
+#include "scene.h"
+#include "test_util.h"
+#include <assert.h>
+#include <stdlib.h>
+
+#define BLOCKS 5000
+
+// Tests that tracked allocations are counted under their tags,
+// and that their live bytes are released when they are freed
+void test_tagged_allocations() {
+    AllocStats before = alloc_tracker_get(ALLOC_TEXT);
+    char *text = alloc_tracker_malloc(ALLOC_TEXT, 100);
+    text = alloc_tracker_realloc(ALLOC_TEXT, text, 300);
+    AllocStats during = alloc_tracker_get(ALLOC_TEXT);
+    assert(during.allocations == before.allocations + 2);
+    assert(during.bytes == before.bytes + 400);
+    assert(during.live_bytes == before.live_bytes + 300);
+    assert(during.peak_live_bytes >= during.live_bytes);
+    alloc_tracker_free(text);
+    AllocStats after = alloc_tracker_get(ALLOC_TEXT);
+    assert(after.frees == before.frees + 2);
+    assert(after.live_bytes == before.live_bytes);
+}
+
+// Tests that many blocks, freed in a different order than they were allocated,
+// are all found in the tracker's table
+void test_many_blocks() {
+    AllocStats total_before = alloc_tracker_total();
+    AllocStats body_before = alloc_tracker_get(ALLOC_BODY);
+    void **blocks = malloc(BLOCKS * sizeof(void *));
+    for (size_t i = 0; i < BLOCKS; i++) {
+        blocks[i] = alloc_tracker_malloc(ALLOC_BODY, i % 64 + 1);
+    }
+    for (size_t i = 0; i < BLOCKS; i++) {
+        alloc_tracker_free(blocks[i * 7919 % BLOCKS]);
+    }
+    free(blocks);
+    assert(alloc_tracker_total().live_bytes == total_before.live_bytes);
+    assert(alloc_tracker_get(ALLOC_BODY).frees == body_before.frees + BLOCKS);
+}
+
+// Tests that with tracking enabled, the library's own allocations are counted too
+void test_library_allocations() {
+    Scene *scene = scene_init();
+    List *shape = rectangle_points(VEC_ZERO, 2, 2);
+    scene_add_body(scene, body_init(shape, 1, (RGBColor) {0, 0, 0}));
+    assert(!alloc_tracker_enabled() || alloc_tracker_get(ALLOC_SCENE).live_bytes > 0);
+    assert(!alloc_tracker_enabled() || alloc_tracker_get(ALLOC_BODY).live_bytes > 0);
+    scene_free(scene);
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_tagged_allocations)
+    DO_TEST(test_many_blocks)
+    DO_TEST(test_library_allocations)
+
+    puts("alloc_tracker_test PASS");
+    return 0;
+}
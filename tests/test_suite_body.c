@@ -72,6 +72,97 @@ void test_body_setters() {
     body_free(body);
 }
 
+// Tests that rotations are absolute and survive later translations
+void test_body_rotation() {
+    List *shape = list_init(4, free);
+    Vector v[] = {{-2, -1}, {+2, -1}, {+2, +1}, {-2, +1}};
+    for (size_t i = 0; i < 4; i++) {
+        Vector *list_v = malloc(sizeof(*list_v));
+        *list_v = v[i];
+        list_add(shape, list_v);
+    }
+    Body *body = body_init(shape, 1, (RGBColor) {0, 0, 0});
+    body_set_rotation(body, M_PI / 2);
+    body_set_rotation(body, M_PI / 2);
+    assert(isclose(body_get_rotation(body), M_PI / 2));
+    body_set_centroid(body, (Vector) {10, 0});
+    const VectorArray *vertices = body_get_vertices(body);
+    assert(vertices->size == 4);
+    for (size_t i = 0; i < 4; i++) {
+        Vector expected = vec_add((Vector) {10, 0}, vec_rotate(v[i], M_PI / 2));
+        assert(vec_isclose(vertices->data[i], expected));
+    }
+    body_set_rotation(body, 0);
+    vertices = body_get_vertices(body);
+    for (size_t i = 0; i < 4; i++) {
+        assert(vec_isclose(vertices->data[i], vec_add((Vector) {10, 0}, v[i])));
+    }
+    body_free(body);
+}
+
+// Tests that bodies sharing a shape can be moved and freed independently
+void test_shared_shape() {
+    List *points = list_init(4, free);
+    Vector v[] = {{0, 0}, {2, 0}, {2, 1}, {0, 1}};
+    for (size_t i = 0; i < 4; i++) {
+        Vector *list_v = malloc(sizeof(*list_v));
+        *list_v = v[i];
+        list_add(points, list_v);
+    }
+    Shape *shape = shape_init(points);
+    assert(isclose(shape_get_area(shape), 2));
+    assert(vec_isclose(shape_get_centroid(shape), (Vector) {1, 0.5}));
+    const VectorArray *normals = shape_get_normals(shape);
+    assert(vec_isclose(normals->data[0], (Vector) {0, -1}));
+    assert(vec_isclose(normals->data[1], (Vector) {1, 0}));
+
+    Body *body1 = body_init_with_shape(shape, 1, (RGBColor) {0, 0, 0}, NULL, NULL);
+    Body *body2 = body_init_with_shape(shape, 1, (RGBColor) {0, 0, 0}, NULL, NULL);
+    shape_release(shape);
+    assert(body_get_prototype(body1) == body_get_prototype(body2));
+    assert(vec_isclose(body_get_centroid(body1), (Vector) {1, 0.5}));
+    body_set_centroid(body2, (Vector) {5, 5});
+    assert(vec_isclose(body_get_vertices(body1)->data[0], (Vector) {0, 0}));
+    assert(vec_isclose(body_get_vertices(body2)->data[0], (Vector) {4, 4.5}));
+    body_free(body1);
+    assert(vec_isclose(body_get_vertices(body2)->data[2], (Vector) {6, 5.5}));
+    body_free(body2);
+}
+
+// Tests that a body's bounding box and normals follow it as it moves and rotates
+void test_body_cached_geometry() {
+    List *points = list_init(4, free);
+    Vector v[] = {{0, 0}, {2, 0}, {2, 1}, {0, 1}};
+    for (size_t i = 0; i < 4; i++) {
+        Vector *list_v = malloc(sizeof(*list_v));
+        *list_v = v[i];
+        list_add(points, list_v);
+    }
+    Body *body = body_init(points, 1, (RGBColor) {0, 0, 0});
+    Vector min, max;
+    body_get_bounds(body, &min, &max);
+    assert(vec_isclose(min, (Vector) {0, 0}));
+    assert(vec_isclose(max, (Vector) {2, 1}));
+
+    // Moving the body keeps the normals, but moves the bounding box
+    const VectorArray *normals = body_get_normals(body);
+    body_set_centroid(body, (Vector) {11, 10.5});
+    assert(body_get_normals(body) == normals);
+    assert(vec_isclose(normals->data[1], (Vector) {1, 0}));
+    body_get_bounds(body, &min, &max);
+    assert(vec_isclose(min, (Vector) {10, 10}));
+    assert(vec_isclose(max, (Vector) {12, 11}));
+
+    body_set_rotation(body, M_PI / 2);
+    normals = body_get_normals(body);
+    assert(vec_isclose(normals->data[0], (Vector) {1, 0}));
+    assert(vec_isclose(normals->data[1], (Vector) {0, 1}));
+    body_get_bounds(body, &min, &max);
+    assert(vec_isclose(min, (Vector) {10.5, 9.5}));
+    assert(vec_isclose(max, (Vector) {11.5, 11.5}));
+    body_free(body);
+}
+
 void test_body_tick() {
     const Vector A = {1, 2};
     const double DT = 1e-6;
@@ -248,6 +339,9 @@ int main(int argc, char *argv[]) {
 
     DO_TEST(test_body_init)
     DO_TEST(test_body_setters)
+    DO_TEST(test_body_rotation)
+    DO_TEST(test_shared_shape)
+    DO_TEST(test_body_cached_geometry)
     DO_TEST(test_body_tick)
     DO_TEST(test_infinite_mass)
     DO_TEST(test_forces)
@@ -1,4 +1,6 @@
 #include "forces.h"
+#include "polygon.h"
+#include "spring_network.h"
 #include "test_util.h"
 #include <assert.h>
 #include <math.h>
@@ -131,6 +133,25 @@ void test_collisions() {
     scene_free(scene);
 }
 
+// Tests that a repeated vertex (a zero-length edge) doesn't stop a shape from colliding
+void test_collision_duplicate_vertex() {
+    List *shape = make_shape();
+    Vector *v = malloc(sizeof(*v));
+    *v = *(Vector *) list_get(shape, list_size(shape) - 1);
+    list_add(shape, v);
+    List *other = make_shape();
+    polygon_translate(other, (Vector) {1.5, 0.5});
+    CollisionInfo info = find_collision(shape, other);
+    assert(info.collided);
+    assert(isclose(info.overlap, 0.5));
+    assert(vec_isclose(info.axis, (Vector) {1, 0}));
+
+    polygon_translate(other, (Vector) {1, 0});
+    assert(!find_collision(shape, other).collided);
+    list_free(shape);
+    list_free(other);
+}
+
 // Tests that force creators properly register their list of affected bodies.
 // If they don't, asan will report a heap-use-after-free failure.
 void test_forces_removed() {
@@ -152,6 +173,448 @@ void test_forces_removed() {
     scene_free(scene);
 }
 
+// Runs one tick of a cloud of bodies attracting each other, either in a
+// gravity group with the given theta and direct_max or (if theta is negative)
+// in pairs, and stores the bodies' resulting velocities
+void gravity_cloud_velocities(
+    double theta, size_t direct_max, Vector *velocities, size_t count
+) {
+    const double G = 10;
+    Scene *scene = scene_init();
+    GravityGroup *group = NULL;
+    if (theta >= 0) {
+        group = create_gravity_group(scene, G, theta);
+        gravity_group_set_direct_max(group, direct_max);
+    }
+    for (size_t i = 0; i < count; i++) {
+        Body *body = body_init(make_shape(), 1 + i % 3, (RGBColor) {0, 0, 0});
+        // A spiral, so the bodies are spread over many cells of the tree
+        double angle = i * 2.4;
+        body_set_centroid(body, vec_multiply(3 * sqrt(i), (Vector) {cos(angle), sin(angle)}));
+        scene_add_body(scene, body);
+        if (group != NULL) {
+            gravity_group_add(group, body);
+        }
+        else {
+            for (size_t j = 0; j < i; j++) {
+                create_newtonian_gravity(scene, G, body, scene_get_body(scene, j));
+            }
+        }
+    }
+    scene_tick(scene, 1);
+    for (size_t i = 0; i < count; i++) {
+        velocities[i] = body_get_velocity(scene_get_body(scene, i));
+    }
+    scene_free(scene);
+}
+
+// Tests that a gravity group matches the pairwise forces exactly with the
+// all-pairs kernel or a quadtree with theta 0, and closely when the far
+// bodies are approximated. 203 bodies leave a partial tile and partial lanes.
+void test_gravity_group() {
+    const size_t BODIES = 203;
+    Vector pairs[BODIES], direct[BODIES], exact[BODIES], approximate[BODIES];
+    gravity_cloud_velocities(-1, 0, pairs, BODIES);
+    gravity_cloud_velocities(0.5, BODIES, direct, BODIES);
+    gravity_cloud_velocities(0, 0, exact, BODIES);
+    gravity_cloud_velocities(0.5, 0, approximate, BODIES);
+    // Errors are compared to the mean force, since a few bodies
+    // feel almost no net force
+    double mean_magnitude = 0;
+    for (size_t i = 0; i < BODIES; i++) {
+        mean_magnitude += sqrt(vec_dot(pairs[i], pairs[i])) / BODIES;
+    }
+    for (size_t i = 0; i < BODIES; i++) {
+        Vector direct_error = vec_subtract(direct[i], pairs[i]);
+        Vector exact_error = vec_subtract(exact[i], pairs[i]);
+        Vector approximate_error = vec_subtract(approximate[i], pairs[i]);
+        assert(sqrt(vec_dot(direct_error, direct_error)) < 1e-9 * mean_magnitude);
+        assert(sqrt(vec_dot(exact_error, exact_error)) < 1e-9 * mean_magnitude);
+        assert(sqrt(vec_dot(approximate_error, approximate_error)) < 0.05 * mean_magnitude);
+    }
+}
+
+// Tests that removed bodies leave a gravity group instead of dangling in it.
+// If they don't, asan will report a heap-use-after-free failure.
+void test_gravity_group_removal() {
+    Scene *scene = scene_init();
+    GravityGroup *group = create_gravity_group(scene, 1, 0.5);
+    for (int i = 0; i < 10; i++) {
+        Body *body = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+        body_set_centroid(body, (Vector) {2 * i, i});
+        scene_add_body(scene, body);
+        gravity_group_add(group, body);
+    }
+    while (scene_bodies(scene) > 0) {
+        scene_remove_body(scene, 0);
+        scene_tick(scene, 1);
+        assert(gravity_group_size(group) == scene_bodies(scene));
+    }
+    scene_free(scene);
+}
+
+// Builds a chain of bodies hanging from an anchor, connected either by a
+// spring network or by separate springs, and ticks it
+void spring_chain_positions(bool network, Vector *positions, size_t count) {
+    const double K = 3;
+    Scene *scene = scene_init();
+    SpringNetwork *springs = network ? create_spring_network(scene) : NULL;
+    Body *anchor = body_init(make_shape(), INFINITY, (RGBColor) {0, 0, 0});
+    scene_add_body(scene, anchor);
+    if (network) {
+        spring_network_add_body(springs, anchor);
+    }
+    for (size_t i = 1; i <= count; i++) {
+        Body *body = body_init(make_shape(), i, (RGBColor) {0, 0, 0});
+        body_set_centroid(body, (Vector) {i, i % 2});
+        scene_add_body(scene, body);
+        if (network) {
+            size_t node = spring_network_add_body(springs, body);
+            spring_network_add_spring(springs, node, node - 1, K, 0);
+        }
+        else {
+            create_spring(scene, K, body, scene_get_body(scene, i - 1));
+        }
+    }
+    for (int i = 0; i < 100; i++) {
+        scene_tick(scene, 0.01);
+    }
+    for (size_t i = 0; i < count; i++) {
+        positions[i] = body_get_centroid(scene_get_body(scene, i + 1));
+    }
+    scene_free(scene);
+}
+
+// Tests that a spring network applies the same forces as separate springs
+void test_spring_network() {
+    const size_t BODIES = 5;
+    Vector separate[BODIES], network[BODIES];
+    spring_chain_positions(false, separate, BODIES);
+    spring_chain_positions(true, network, BODIES);
+    for (size_t i = 0; i < BODIES; i++) {
+        assert(vec_isclose(separate[i], network[i]));
+    }
+}
+
+// Tests that a stretched spring with a rest length pulls its bodies together,
+// and that removing a body removes its springs
+void test_spring_network_rest_length() {
+    Scene *scene = scene_init();
+    SpringNetwork *springs = create_spring_network(scene);
+    Body *body1 = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    Body *body2 = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    body_set_centroid(body2, (Vector) {3, 0});
+    scene_add_body(scene, body1);
+    scene_add_body(scene, body2);
+    spring_network_add_spring(
+        springs, spring_network_add_body(springs, body1), spring_network_add_body(springs, body2), 5, 2
+    );
+    scene_tick(scene, 0.1);
+    assert(vec_isclose(body_get_velocity(body1), (Vector) {0.5, 0}));
+    assert(vec_isclose(body_get_velocity(body2), (Vector) {-0.5, 0}));
+    body_remove(body2);
+    scene_tick(scene, 0.1);
+    assert(spring_network_springs(springs) == 0);
+    scene_tick(scene, 0.1);
+    scene_free(scene);
+}
+
+// Tests that the bodies of a spring network sleep and wake together,
+// and that a sleeping network doesn't wake its bodies by pulling on them
+void test_spring_network_sleeping() {
+    Scene *scene = scene_init();
+    // Slow enough that the bodies count as resting from the start
+    scene_set_sleeping(scene, 10, 0.3);
+    SpringNetwork *springs = create_spring_network(scene);
+    Body *body1 = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    Body *body2 = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    body_set_centroid(body2, (Vector) {3, 0});
+    scene_add_body(scene, body1);
+    scene_add_body(scene, body2);
+    spring_network_add_spring(
+        springs, spring_network_add_body(springs, body1), spring_network_add_body(springs, body2), 1, 2
+    );
+
+    for (int i = 0; i < 4; i++) {
+        scene_tick(scene, 0.1);
+    }
+    assert(body_is_asleep(body1));
+    assert(body_is_asleep(body2));
+    Vector position = body_get_centroid(body2);
+    for (int i = 0; i < 4; i++) {
+        scene_tick(scene, 0.1);
+        assert(body_is_asleep(body1));
+        assert(body_is_asleep(body2));
+    }
+    assert(vec_isclose(body_get_centroid(body2), position));
+
+    // Waking one body wakes the whole network
+    body_set_velocity(body1, (Vector) {1, 0});
+    scene_tick(scene, 0.1);
+    assert(!body_is_asleep(body1));
+    assert(!body_is_asleep(body2));
+    assert(body_get_velocity(body2).x < 0);
+    scene_free(scene);
+}
+
+// The largest distance from its anchor reached by a body on a very stiff spring
+double stiff_spring_amplitude(bool implicit) {
+    const double DT = 0.1;
+    Scene *scene = scene_init();
+    scene_set_integrator(scene, INTEGRATOR_SYMPLECTIC_EULER);
+    SpringNetwork *springs = create_spring_network(scene);
+    spring_network_set_implicit(springs, implicit);
+    Body *anchor = body_init(make_shape(), INFINITY, (RGBColor) {0, 0, 0});
+    Body *body = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    body_set_centroid(body, (Vector) {1, 0});
+    scene_add_body(scene, anchor);
+    scene_add_body(scene, body);
+    spring_network_add_spring(
+        springs, spring_network_add_body(springs, anchor), spring_network_add_body(springs, body), 1e4, 0
+    );
+    double amplitude = 0;
+    for (int i = 0; i < 100; i++) {
+        scene_tick(scene, DT);
+        amplitude = fmax(amplitude, fabs(body_get_centroid(body).x));
+    }
+    scene_free(scene);
+    return amplitude;
+}
+
+// Tests that an implicit network stays stable with a spring too stiff for dt
+void test_spring_network_implicit() {
+    assert(stiff_spring_amplitude(false) > 100);
+    assert(stiff_spring_amplitude(true) <= 1);
+}
+
+// The speed of a body after sliding for a second with the given damping
+double damped_speed(double linear, double quadratic, bool exact, bool drag) {
+    const double DT = 0.1;
+    Scene *scene = scene_init();
+    scene_set_exact_damping(scene, exact);
+    Body *body = body_init(make_shape(), 2, (RGBColor) {0, 0, 0});
+    body_set_velocity(body, (Vector) {6, 8});
+    scene_add_body(scene, body);
+    if (drag) {
+        create_drag(scene, linear, body);
+    }
+    else {
+        body_set_damping(body, linear, quadratic);
+    }
+    for (int i = 0; i < 10; i++) {
+        scene_tick(scene, DT);
+    }
+    Vector v = body_get_velocity(body);
+    // Damping never changes the direction of motion
+    assert(isclose(v.x * 8, v.y * 6));
+    scene_free(scene);
+    return sqrt(vec_dot(v, v));
+}
+
+// Tests that damping forces match create_drag(), and that exact damping
+// decays the speed as the damping equation does
+void test_damping() {
+    // Linear damping as a force loses gamma / m * dt of the speed each tick
+    assert(isclose(damped_speed(4, 0, false, false), 10 * pow(0.8, 10)));
+    assert(isclose(damped_speed(4, 0, false, true), 10 * pow(0.8, 10)));
+    assert(isclose(damped_speed(4, 0, true, false), 10 * exp(-2)));
+    assert(isclose(damped_speed(0, 1, true, false), 10 / (1 + 0.5 * 10)));
+    // ds/dt = -2s - s^2/2, so s = 2 * 10 e^-2t / (2 + 10 / 2 (1 - e^-2t))
+    assert(isclose(damped_speed(4, 1, true, false), 20 * exp(-2) / (2 + 5 * (1 - exp(-2)))));
+    // Damping too strong for dt reverses the velocity, unless it is exact
+    assert(damped_speed(100, 0, false, false) > 10);
+    assert(damped_speed(100, 0, true, false) < 1e-10);
+}
+
+// Tests that a uniform field accelerates every body equally,
+// and that changing the field in place takes effect immediately
+void test_uniform_gravity() {
+    const double DT = 0.1;
+    const int STEPS = 10;
+    Scene *scene = scene_init();
+    GravityField field = {.acceleration = {0, -2}};
+    Body *light = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    Body *heavy = body_init(make_shape(), 5, (RGBColor) {0, 0, 0});
+    Body *wall = body_init(make_shape(), INFINITY, (RGBColor) {0, 0, 0});
+    scene_add_body(scene, light);
+    scene_add_body(scene, heavy);
+    scene_add_body(scene, wall);
+    create_uniform_gravity(scene, &field, light);
+    create_uniform_gravity(scene, &field, heavy);
+    create_uniform_gravity(scene, &field, wall);
+    for (int i = 0; i < STEPS; i++) {
+        scene_tick(scene, DT);
+    }
+    assert(vec_isclose(body_get_centroid(light), (Vector) {0, -1}));
+    assert(vec_isclose(body_get_centroid(heavy), (Vector) {0, -1}));
+    assert(vec_isclose(body_get_velocity(heavy), (Vector) {0, -2}));
+    assert(vec_isclose(body_get_centroid(wall), VEC_ZERO));
+
+    field.acceleration = (Vector) {0, 2};
+    for (int i = 0; i < STEPS; i++) {
+        scene_tick(scene, DT);
+    }
+    assert(vec_isclose(body_get_velocity(light), VEC_ZERO));
+    assert(vec_isclose(body_get_centroid(light), (Vector) {0, -2}));
+    scene_free(scene);
+}
+
+// Tests that changing a field's acceleration wakes the sleeping bodies in it
+void test_uniform_gravity_sleeping() {
+    Scene *scene = scene_init();
+    scene_set_sleeping(scene, 0.05, 0.5);
+    GravityField field = {.acceleration = {0, -10}};
+    Body *body = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    body_set_centroid(body, (Vector) {0, 1});
+    scene_add_body(scene, body);
+    create_uniform_gravity(scene, &field, body);
+    create_half_plane(scene, VEC_ZERO, (Vector) {0, 1}, 0, body);
+    for (int i = 0; i < 200; i++) {
+        scene_tick(scene, 0.01);
+    }
+    assert(body_is_asleep(body));
+
+    field.acceleration = (Vector) {0, 10};
+    for (int i = 0; i < 100; i++) {
+        scene_tick(scene, 0.01);
+    }
+    assert(!body_is_asleep(body));
+    assert(body_get_velocity(body).y > 9);
+    assert(body_get_centroid(body).y > 5);
+    scene_free(scene);
+}
+
+// Tests that a body falling onto a half-plane comes to rest on top of it
+void test_half_plane() {
+    Scene *scene = scene_init();
+    GravityField field = {.acceleration = {0, -10}};
+    Body *body = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    body_set_centroid(body, (Vector) {0, 5});
+    body_set_velocity(body, (Vector) {1, 0});
+    scene_add_body(scene, body);
+    create_uniform_gravity(scene, &field, body);
+    create_half_plane(scene, VEC_ZERO, (Vector) {0, 2}, 0, body);
+    for (int i = 0; i < 200; i++) {
+        scene_tick(scene, 0.01);
+        // The bottom of the square never goes through the plane
+        assert(body_get_centroid(body).y >= 1 - 1e-9);
+    }
+    assert(isclose(body_get_centroid(body).y, 1));
+    // Only the velocity into the plane is removed
+    assert(vec_isclose(body_get_velocity(body), (Vector) {1, 0}));
+
+    // The body can leave the plane freely
+    body_set_velocity(body, (Vector) {0, 20});
+    scene_tick(scene, 0.01);
+    assert(body_get_centroid(body).y > 1);
+    scene_free(scene);
+}
+
+// Tests that a stack of boxes resting on the ground under gravity
+// settles without sinking into each other
+void test_resting_stack() {
+    const int BOXES = 4;
+    Scene *scene = scene_init();
+    GravityField field = {.acceleration = {0, -10}};
+    Body *ground = body_init(make_shape(), INFINITY, (RGBColor) {0, 0, 0});
+    body_set_type(ground, BODY_STATIC);
+    scene_add_body(scene, ground);
+    Body *boxes[BOXES];
+    for (int i = 0; i < BOXES; i++) {
+        boxes[i] = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+        body_set_centroid(boxes[i], (Vector) {0, 2.5 * (i + 1)});
+        scene_add_body(scene, boxes[i]);
+        create_uniform_gravity(scene, &field, boxes[i]);
+        create_physics_collision(scene, 0, i == 0 ? ground : boxes[i - 1], boxes[i]);
+    }
+    for (int i = 0; i < 1000; i++) {
+        scene_tick(scene, 0.01);
+    }
+    for (int i = 0; i < BOXES; i++) {
+        assert(fabs(body_get_centroid(boxes[i]).y - 2 * (i + 1)) < 1e-2);
+        assert(fabs(body_get_velocity(boxes[i]).y) < 1e-1);
+    }
+    scene_free(scene);
+}
+
+// Runs a mass on a spring with a coarse step using a given integrator,
+// and returns the largest relative error in its energy
+double spring_energy_error(Integrator integrator, double dt, int steps) {
+    const double M = 10;
+    const double K = 2;
+    const double A = 3;
+    Scene *scene = scene_init();
+    scene_set_integrator(scene, integrator);
+    Body *mass = body_init(make_shape(), M, (RGBColor) {0, 0, 0});
+    body_set_centroid(mass, (Vector) {A, 0});
+    scene_add_body(scene, mass);
+    Body *anchor = body_init(make_shape(), INFINITY, (RGBColor) {0, 0, 0});
+    scene_add_body(scene, anchor);
+    create_spring(scene, K, mass, anchor);
+    double initial_energy = K * A * A / 2;
+    double max_error = 0;
+    for (int i = 0; i < steps; i++) {
+        scene_tick(scene, dt);
+        Vector x = body_get_centroid(mass);
+        double energy = kinetic_energy(mass) + K * vec_dot(x, x) / 2;
+        max_error = fmax(max_error, fabs(energy - initial_energy) / initial_energy);
+    }
+    scene_free(scene);
+    return max_error;
+}
+
+// Tests that the integrators stay stable at a step 10^5 times coarser
+// than test_spring_sinusoid() uses, with the expected ranking in accuracy
+void test_integrators() {
+    const double DT = 0.1;
+    const int STEPS = 10000;
+    double euler = spring_energy_error(INTEGRATOR_SYMPLECTIC_EULER, DT, STEPS);
+    double verlet = spring_energy_error(INTEGRATOR_VELOCITY_VERLET, DT, STEPS);
+    double rk4 = spring_energy_error(INTEGRATOR_RK4, DT, STEPS);
+    assert(euler < 0.1);
+    assert(verlet < 0.01);
+    assert(rk4 < 1e-4);
+    assert(rk4 < verlet && verlet < euler);
+}
+
+// The largest distance between a mass on a spring and its exact position,
+// ticked with the given adaptive substepping
+double spring_position_error(double substep_motion, double dt, int steps) {
+    const double M = 10;
+    const double K = 2;
+    const double A = 3;
+    Scene *scene = scene_init();
+    scene_set_integrator(scene, INTEGRATOR_SYMPLECTIC_EULER);
+    scene_set_adaptive_substeps(scene, substep_motion, 64);
+    Body *mass = body_init(make_shape(), M, (RGBColor) {0, 0, 0});
+    body_set_centroid(mass, (Vector) {A, 0});
+    scene_add_body(scene, mass);
+    Body *anchor = body_init(make_shape(), INFINITY, (RGBColor) {0, 0, 0});
+    scene_add_body(scene, anchor);
+    create_spring(scene, K, mass, anchor);
+    double omega = sqrt(K / M);
+    double max_error = 0;
+    for (int i = 1; i <= steps; i++) {
+        scene_tick(scene, dt);
+        double expected = A * cos(omega * i * dt);
+        max_error = fmax(max_error, fabs(body_get_centroid(mass).x - expected));
+    }
+    scene_free(scene);
+    return max_error;
+}
+
+// Tests that a fast body is substepped, re-evaluating its spring force,
+// and that a slow body takes exactly the same single step as before
+void test_adaptive_substeps() {
+    const double DT = 1;
+    const int STEPS = 30;
+    double single = spring_position_error(0, DT, STEPS);
+    double substepped = spring_position_error(0.01, DT, STEPS);
+    double slow = spring_position_error(100, DT, STEPS);
+    assert(substepped < single / 5);
+    assert(slow == single);
+}
+
 int main(int argc, char *argv[]) {
     // Run all tests if there are no command-line arguments
     bool all_tests = argc == 1;
@@ -164,7 +627,21 @@ int main(int argc, char *argv[]) {
     DO_TEST(test_spring_sinusoid)
     DO_TEST(test_energy_conservation)
     DO_TEST(test_collisions)
+    DO_TEST(test_collision_duplicate_vertex)
     DO_TEST(test_forces_removed)
+    DO_TEST(test_gravity_group)
+    DO_TEST(test_gravity_group_removal)
+    DO_TEST(test_spring_network)
+    DO_TEST(test_spring_network_rest_length)
+    DO_TEST(test_spring_network_sleeping)
+    DO_TEST(test_spring_network_implicit)
+    DO_TEST(test_damping)
+    DO_TEST(test_uniform_gravity)
+    DO_TEST(test_uniform_gravity_sleeping)
+    DO_TEST(test_half_plane)
+    DO_TEST(test_resting_stack)
+    DO_TEST(test_integrators)
+    DO_TEST(test_adaptive_substeps)
 
     puts("forces_test PASS");
     return 0;
@@ -1,3 +1,4 @@
+#include "forces.h"
 #include "scene.h"
 #include "test_util.h"
 #include <assert.h>
@@ -233,6 +234,319 @@ void test_reaping() {
     scene_free(scene);
 }
 
+void test_unstable_removal() {
+    Scene *scene = scene_init();
+    scene_set_stable_removal(scene, false);
+    Body *bodies[5];
+    for (int i = 0; i < 5; i++) {
+        bodies[i] = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+        scene_add_body(scene, bodies[i]);
+    }
+    body_remove(bodies[0]);
+    body_remove(bodies[2]);
+    scene_tick(scene, 1);
+    // Each hole is filled with the body that was last in the scene
+    assert(scene_bodies(scene) == 3);
+    assert(scene_get_body(scene, 0) == bodies[4]);
+    assert(scene_get_body(scene, 1) == bodies[1]);
+    assert(scene_get_body(scene, 2) == bodies[3]);
+    scene_free(scene);
+}
+
+void increment(void *aux) {
+    (*(int *) aux)++;
+}
+
+// Tests that a force creator with more than FORCER_INLINE_BODIES bodies
+// is still removed when its last body is removed
+void test_many_body_force_creator() {
+    const size_t BODIES = FORCER_INLINE_BODIES + 3;
+    Scene *scene = scene_init();
+    Body *bodies[BODIES];
+    for (size_t i = 0; i < BODIES; i++) {
+        bodies[i] = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+        scene_add_body(scene, bodies[i]);
+    }
+    int count = 0;
+    scene_add_force_creator_with_bodies(
+        scene, increment, &count, bodies, BODIES, NULL
+    );
+    scene_tick(scene, 1);
+    assert(count == 1);
+    body_remove(bodies[BODIES - 1]);
+    scene_tick(scene, 1);
+    scene_tick(scene, 1);
+    assert(count == 2);
+    scene_free(scene);
+}
+
+void push_right(void *body) {
+    body_add_force((Body *) body, (Vector) {1, 0});
+    body_add_impulse((Body *) body, (Vector) {1, 0});
+}
+
+// The number of times push_batch_right() has been called, and on how many bodies
+int batch_calls = 0;
+int batch_pushes = 0;
+int batch_cleanups = 0;
+
+void push_batch_right(void *params, size_t count) {
+    batch_calls++;
+    for (size_t i = 0; i < count; i++) {
+        push_right(((Body **) params)[i]);
+        batch_pushes++;
+    }
+}
+
+void count_batch_cleanup(void *params) {
+    batch_cleanups++;
+}
+
+// Tests that batched force creators are run with one call per tick,
+// and are removed (in order) along with their bodies
+void test_batched_force_creator() {
+    const size_t BODIES = 10;
+    Scene *scene = scene_init();
+    Body *bodies[BODIES];
+    for (size_t i = 0; i < BODIES; i++) {
+        bodies[i] = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+        scene_add_body(scene, bodies[i]);
+        Body **params = scene_add_batched_force_creator(
+            scene, push_batch_right, sizeof(Body *), &bodies[i], 1, count_batch_cleanup
+        );
+        *params = bodies[i];
+    }
+    scene_tick(scene, 1);
+    assert(batch_calls == 1 && batch_pushes == BODIES);
+    body_remove(bodies[3]);
+    scene_tick(scene, 1);
+    assert(batch_cleanups == 1);
+    scene_tick(scene, 1);
+    assert(batch_calls == 3 && batch_pushes == 3 * BODIES - 1);
+    // The other bodies were pushed on every tick
+    for (size_t i = 0; i < BODIES; i++) {
+        if (i != 3) {
+            assert(body_get_velocity(bodies[i]).x == 6);
+        }
+    }
+    scene_free(scene);
+    assert(batch_cleanups == BODIES);
+}
+
+void test_kinematic_body() {
+    Scene *scene = scene_init();
+    Body *dynamic = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    Body *kinematic = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    body_set_type(kinematic, BODY_KINEMATIC);
+    body_set_velocity(kinematic, (Vector) {0, -2});
+    scene_add_body(scene, dynamic);
+    scene_add_body(scene, kinematic);
+    assert(scene_get_body(scene, 1) == kinematic);
+    scene_add_force_creator_with_bodies(scene, push_right, kinematic, &kinematic, 1, NULL);
+    scene_add_force_creator_with_bodies(scene, push_right, dynamic, &dynamic, 1, NULL);
+    for (int i = 0; i < 3; i++) {
+        scene_tick(scene, 0.5);
+    }
+    // The kinematic body ignores the forces and impulses pushing it
+    assert(vec_isclose(body_get_velocity(kinematic), (Vector) {0, -2}));
+    assert(vec_isclose(body_get_centroid(kinematic), (Vector) {0, -3}));
+    assert(body_get_velocity(dynamic).x > 0);
+    body_remove(kinematic);
+    scene_tick(scene, 0.5);
+    assert(scene_bodies(scene) == 1);
+    scene_free(scene);
+}
+
+void test_static_body() {
+    Scene *scene = scene_init();
+    Body *wall = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    body_set_type(wall, BODY_STATIC);
+    body_set_velocity(wall, (Vector) {1, 1});
+    scene_add_body(scene, wall);
+    Body *ball = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    body_set_centroid(ball, (Vector) {-5, 0});
+    body_set_velocity(ball, (Vector) {10, 0});
+    scene_add_body(scene, ball);
+    scene_add_force_creator_with_bodies(scene, push_right, wall, &wall, 1, NULL);
+    create_physics_collision(scene, 1, ball, wall);
+    for (int i = 0; i < 10; i++) {
+        scene_tick(scene, 0.1);
+    }
+    // The static body never moves, but the ball still bounces off it
+    assert(vec_isclose(body_get_centroid(wall), VEC_ZERO));
+    assert(body_get_velocity(ball).x < 0);
+    scene_free(scene);
+}
+
+void test_sleeping_island() {
+    Scene *scene = scene_init();
+    scene_set_sleeping(scene, 0.1, 0.5);
+    Body *body1 = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    Body *body2 = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    Body *mover = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    body_set_type(mover, BODY_KINEMATIC);
+    body_set_centroid(mover, (Vector) {-10, 0});
+    body_set_velocity(mover, (Vector) {10, 0});
+    scene_add_body(scene, body1);
+    scene_add_body(scene, body2);
+    scene_add_body(scene, mover);
+    create_spring(scene, 1, body1, body2);
+    create_physics_collision(scene, 1, mover, body1);
+
+    for (int i = 0; i < 6; i++) {
+        scene_tick(scene, 0.1);
+    }
+    assert(body_is_asleep(body1));
+    assert(body_is_asleep(body2));
+    assert(!body_is_asleep(mover));
+
+    // The moving body knocks body1 awake, which wakes up body2 as well
+    for (int i = 0; i < 6; i++) {
+        scene_tick(scene, 0.1);
+    }
+    assert(!body_is_asleep(body1));
+    assert(!body_is_asleep(body2));
+    assert(body_get_velocity(body1).x > 0);
+    scene_free(scene);
+}
+
+// Records the first vertex and how many polygons scene_render() draws
+typedef struct {
+    size_t polygons;
+    Vector first_vertex;
+} RecordedDrawing;
+
+void record_polygon(void *aux, const Vector *vertices, size_t count, RGBColor color) {
+    RecordedDrawing *drawing = aux;
+    if (drawing->polygons == 0) {
+        drawing->first_vertex = vertices[0];
+    }
+    drawing->polygons++;
+}
+
+// Tests that scene_render() draws the bodies between their last two states
+void test_render_interpolation() {
+    Scene *scene = scene_init();
+    Body *body = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    body_set_velocity(body, (Vector) {4, 0});
+    scene_add_body(scene, body);
+    RecordedDrawing drawing;
+    SceneView view = {.draw_polygon = record_polygon, .aux = &drawing};
+
+    // Ticking the scene doesn't draw anything
+    drawing = (RecordedDrawing) {0};
+    scene_tick(scene, 0.5);
+    assert(drawing.polygons == 0);
+
+    scene_render(scene, &view, 1);
+    assert(drawing.polygons == 1);
+    assert(vec_isclose(drawing.first_vertex, (Vector) {1, -1}));
+    drawing = (RecordedDrawing) {0};
+    scene_render(scene, &view, 0);
+    assert(vec_isclose(drawing.first_vertex, (Vector) {-1, -1}));
+    drawing = (RecordedDrawing) {0};
+    scene_render(scene, &view, 0.25);
+    assert(vec_isclose(drawing.first_vertex, (Vector) {-0.5, -1}));
+
+    // Rotation is interpolated too
+    body_set_velocity(body, VEC_ZERO);
+    scene_tick(scene, 0.5);
+    body_set_rotation(body, M_PI);
+    drawing = (RecordedDrawing) {0};
+    scene_render(scene, &view, 0.5);
+    assert(vec_isclose(drawing.first_vertex, (Vector) {3, -1}));
+    scene_free(scene);
+}
+
+// Tests that bodies which don't move are drawn where they are
+void test_render_still_bodies() {
+    Scene *scene = scene_init();
+    scene_set_sleeping(scene, 1, 0.1);
+    Body *wall = body_init(make_shape(), INFINITY, (RGBColor) {0, 0, 0});
+    body_set_type(wall, BODY_STATIC);
+    scene_add_body(scene, wall);
+    RecordedDrawing drawing;
+    SceneView view = {.draw_polygon = record_polygon, .aux = &drawing};
+
+    // A static body moved between ticks is not interpolated from its old position
+    scene_tick(scene, 0.5);
+    body_set_centroid(wall, (Vector) {5, 0});
+    drawing = (RecordedDrawing) {0};
+    scene_render(scene, &view, 0);
+    assert(vec_isclose(drawing.first_vertex, (Vector) {4, -1}));
+
+    // A body drawn while asleep stays where it stopped
+    scene_remove_body(scene, 0);
+    Body *body = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    body_set_velocity(body, (Vector) {0.5, 0});
+    scene_add_body(scene, body);
+    for (int i = 0; i < 3; i++) {
+        scene_tick(scene, 0.1);
+    }
+    assert(body_is_asleep(body));
+    Vector position = body_get_centroid(body);
+    drawing = (RecordedDrawing) {0};
+    scene_render(scene, &view, 0);
+    assert(vec_isclose(drawing.first_vertex, vec_add(position, (Vector) {-1, -1})));
+    scene_free(scene);
+}
+
+void ignore_collision(Body *body1, Body *body2, Vector axis, void *aux) {}
+
+// Tests that each tick's stage timings and counters are kept over the window
+void test_scene_stats() {
+    Scene *scene = scene_init();
+    SceneStats stats = scene_get_stats(scene);
+    assert(stats.ticks == 0);
+    scene_set_stats_window(scene, 10);
+
+    Body *body1 = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    Body *body2 = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    scene_add_body(scene, body1);
+    scene_add_body(scene, body2);
+    create_collision(scene, body1, body2, ignore_collision, NULL, NULL);
+    for (int i = 0; i < 15; i++) {
+        if (i == 12) {
+            body_remove(body2);
+        }
+        scene_tick(scene, 0.01);
+    }
+
+    stats = scene_get_stats(scene);
+    assert(stats.ticks == 10);
+    assert(stats.forcers_run.max >= 1);
+    assert(stats.sat_tests.max >= 1);
+    assert(stats.bodies_removed.max == 1);
+    // The collision was removed with the body, so nothing ran on the last tick
+    assert(stats.forcers_run.last == 0);
+    assert(stats.sat_tests.last == 0);
+    assert(stats.bodies_removed.last == 0);
+    for (size_t i = 0; i < SCENE_STAGE_COUNT; i++) {
+        SceneSampleStats stage = stats.stages[i];
+        assert(stage.median <= stage.p95);
+        assert(stage.p95 <= stage.p99);
+        assert(stage.p99 <= stage.max);
+        assert(stage.average <= stage.max);
+    }
+    assert(stats.stages[SCENE_STAGE_TICK].average > 0);
+    assert(stats.stages[SCENE_STAGE_TICK].average >= stats.stages[SCENE_STAGE_FORCES].average);
+    assert(stats.stages[SCENE_STAGE_RENDER].max == 0);
+
+    // Bodies removed between ticks are not counted in the next tick
+    Body *body3 = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    scene_add_body(scene, body3);
+    body_remove(body3);
+    scene_tick_delete_only(scene);
+    scene_tick(scene, 0.01);
+    assert(scene_get_stats(scene).bodies_removed.last == 0);
+
+    // Disabling statistics clears them
+    scene_set_stats_window(scene, 0);
+    scene_tick(scene, 0.01);
+    assert(scene_get_stats(scene).ticks == 0);
+    scene_free(scene);
+}
+
 int main(int argc, char *argv[]) {
     // Run all tests if there are no command-line arguments
     bool all_tests = argc == 1;
@@ -247,6 +561,15 @@ int main(int argc, char *argv[]) {
     DO_TEST(test_force_creator)
     DO_TEST(test_force_creator_aux)
     DO_TEST(test_reaping)
+    DO_TEST(test_unstable_removal)
+    DO_TEST(test_many_body_force_creator)
+    DO_TEST(test_batched_force_creator)
+    DO_TEST(test_kinematic_body)
+    DO_TEST(test_static_body)
+    DO_TEST(test_sleeping_island)
+    DO_TEST(test_render_interpolation)
+    DO_TEST(test_render_still_bodies)
+    DO_TEST(test_scene_stats)
 
     puts("scene_test PASS");
     return 0;